@@ -1,5 +1,8 @@
 #include <Arduino.h>
 #include <climits>
+#if !defined(ESP8266)
+#include <atomic>
+#endif
 #include "current.h"
 #include "utils/log.h"
 #include "screen/screen.h"
@@ -7,22 +10,54 @@
 char TAG_CURRENT[] = "Current";
 
 // Global variables
-Job *current_job = nullptr;
+// Jobs are published RCU style: the network side fills the free slot and bumps the epoch,
+// the job left in that slot is only deleted once every worker has moved past its epoch
+Job *current_jobs[2] = {nullptr, nullptr};
+#if defined(ESP8266)
+uint32_t current_epoch = 0;
+uint32_t current_worker_epoch[CORE] = {}; // Epoch + 1 the worker is hashing, 0 when idle
+#else
+std::atomic<uint32_t> current_epoch{0};
+std::atomic<uint32_t> current_worker_epoch[CORE] = {}; // Epoch + 1 the worker is hashing, 0 when idle
+#endif
+char current_job_id[NOTIFICATION_JOB_ID_SIZE + 1] = "";
+uint32_t current_session_epoch = 0; // First epoch of the session, older jobs were given by a dead one
+// Last published jobs by epoch, written and read by the network side only
+current_job_info current_job_history[CURRENT_JOB_HISTORY] = {};
+// Jobs already built, waiting for the published one to be exhausted. Only the network side touches it
+Job *current_job_queue[CURRENT_JOB_QUEUE_SIZE];
+size_t current_job_queue_count = 0;
+// Epoch + 1 of the job a worker has exhausted, serviced by the network side
+#if defined(ESP8266)
+uint32_t current_job_exhausted_epoch = 0;
+#else
+std::atomic<uint32_t> current_job_exhausted_epoch{0};
+#endif
 Subscribe *current_subscribe = nullptr;
-volatile bool current_job_is_valid = false;  // Mude para bool e volatile
 uint64_t current_job_processed = 0;
 double current_difficulty = UINT_MAX;
+Target current_share_target; // Zero until the pool sets a difficulty
+uint32_t current_version_mask = 0; // Version rolling (BIP 310) off until the pool agrees
 double current_difficulty_highest = 0.0;
 uint64_t current_block_found = 0;
 uint64_t current_hash_accepted = 0;
 uint64_t current_hash_rejected = 0;
-uint32_t current_hashes = 0;
-uint64_t current_hashes_time = 0;
+// Each worker counts its hashes in its own cache line, only the stats sampling reads them all
+struct alignas(CURRENT_CACHE_LINE) current_hash_counter
+{
+    volatile uint32_t hashes;
+};
+current_hash_counter current_worker_hashes[CORE] = {};
+uint32_t current_hashes_sampled = 0; // Sum of the counters at the last sample
+uint32_t current_hashes_time = 0;
 double current_hashrate = 0;
 uint64_t current_uptime = 0;
 uint64_t current_last_hash = 0;
 
 // Function prototypes
+bool current_job_publish(Job *job);
+void current_job_start(Job *job);
+void current_job_flush();
 void deleteCurrentJob();
 void deleteCurrentSubscribe();
 void cleanupResources();
@@ -31,7 +66,102 @@ void handleException();
 // Function implementations
 bool current_hasJob()
 {
-    return current_job != nullptr;
+    return current_jobs[current_epoch & 1] != nullptr;
+}
+
+bool current_hasSessionJob()
+{
+    return current_hasJob() && current_job_in_session(current_epoch);
+}
+
+bool current_job_in_session(uint32_t epoch)
+{
+    return (int32_t)(epoch - current_session_epoch) >= 0;
+}
+
+Job *current_job_acquire(uint32_t core)
+{
+    uint32_t epoch;
+    do
+    {
+        epoch = current_epoch;
+        current_worker_epoch[core] = epoch + 1;
+        // A job published meanwhile may already be reclaiming this slot, take the new one
+    } while (epoch != current_epoch);
+    return current_jobs[epoch & 1];
+}
+
+void current_job_release(uint32_t core)
+{
+    current_worker_epoch[core] = 0;
+}
+
+uint32_t current_job_epoch(uint32_t core)
+{
+    return current_worker_epoch[core] - 1;
+}
+
+const current_job_info *current_job_lookup(uint32_t epoch)
+{
+    const current_job_info &info = current_job_history[epoch % CURRENT_JOB_HISTORY];
+    if (info.epoch != epoch || info.job_id[0] == '\0')
+    {
+        return nullptr;
+    }
+    return &info;
+}
+
+bool current_job_quiescent(uint32_t epoch)
+{
+    for (uint32_t core = 0; core < CORE; core++)
+    {
+        const uint32_t worker_epoch = current_worker_epoch[core];
+        if (worker_epoch != 0 && worker_epoch != epoch + 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool current_job_publish(Job *job)
+{
+    const uint32_t epoch = current_epoch;
+    Job *&slot = current_jobs[(epoch + 1) & 1];
+
+    // The free slot still holds the job of the previous epoch, wait until no worker hashes it.
+    // Workers acquire at every batch, so this is at most one batch long.
+#if defined(ESP32)
+    while (!current_job_quiescent(epoch))
+    {
+        vTaskDelay(1);
+    }
+#else
+    // Single core, the worker releases its job before every network call. If it did not,
+    // the slot may still be hashed: keep the published job and drop the new one
+    if (!current_job_quiescent(epoch))
+    {
+        l_error(TAG_CURRENT, "Job published while still in use, keeping %s", current_job_id);
+        delete job;
+        return false;
+    }
+#endif
+    delete slot;
+    slot = job;
+
+    // Shares keep pointing to the job by epoch after it is reclaimed
+    current_job_info &info = current_job_history[(epoch + 1) % CURRENT_JOB_HISTORY];
+    info.epoch = epoch + 1;
+    info.job_id[0] = '\0';
+    if (job != nullptr)
+    {
+        snprintf(current_job_id, sizeof(current_job_id), "%s", job->job_id.c_str());
+        snprintf(info.job_id, sizeof(info.job_id), "%s", job->job_id.c_str());
+        info.extranonce2_size = job->getExtranonce2Size();
+        info.version_mask = job->version_mask;
+    }
+    current_epoch = epoch + 1;
+    return true;
 }
 
 void current_increment_processedJob()
@@ -49,45 +179,137 @@ void current_setJob(const Notification &notification)
             return;
         }
 
-        current_job_is_valid = false;  // Desabilita primeiro
-        
-        Job* new_job = new Job(notification, *current_subscribe, current_difficulty);
-        
-        if (current_job != nullptr)
+        // Montado fora dos slots, os workers só o veem depois de publicado
+        Job* new_job = new Job(notification, *current_subscribe, current_difficulty, current_version_mask);
+
+        // O job mantido de uma sessão anterior é substituído pelo primeiro notify da nova
+        if (notification.clean_jobs || !current_hasSessionJob())
         {
-            if (notification.clean_jobs)
+            // clean_jobs invalida os jobs anteriores, troca na hora e descarta a fila
+            if (current_hasJob())
             {
-                l_debug(TAG_CURRENT, "Job: %s is cleaned and replaced with %s", 
-                    current_job->job_id.c_str(), 
-                    notification.job_id.c_str());
+                l_debug(TAG_CURRENT, "Job: %s is cleaned and replaced with %s", current_job_id, notification.job_id);
             }
-            deleteCurrentJob();
+            current_job_flush();
+            current_job_start(new_job);
+            return;
         }
 
-        current_job = new_job;
-        current_job_is_valid = true;  // Habilita só depois que tudo estiver pronto
-        current_increment_processedJob();
-        l_info(TAG_CURRENT, "Job: %s ready to be mined", current_job->job_id.c_str());
+        // Os shares do job atual continuam válidos, o novo espera até ele se esgotar
+        if (current_job_queue_count == CURRENT_JOB_QUEUE_SIZE)
+        {
+            l_debug(TAG_CURRENT, "Job queue full, dropping %s", current_job_queue[0]->job_id.c_str());
+            delete current_job_queue[0];
+            memmove(current_job_queue, current_job_queue + 1, sizeof(Job *) * (CURRENT_JOB_QUEUE_SIZE - 1));
+            current_job_queue_count--;
+        }
+        current_job_queue[current_job_queue_count++] = new_job;
+        l_info(TAG_CURRENT, "Job: %s queued (%d)", new_job->job_id.c_str(), current_job_queue_count);
+        current_job_service();
     }
     catch (...)
     {
-        current_job_is_valid = false;
         handleException();
     }
 }
 
+void current_job_start(Job *job)
+{
+    current_job_exhausted_epoch = 0;
+    if (!current_job_publish(job))
+    {
+        return;
+    }
+    current_increment_processedJob();
+    l_info(TAG_CURRENT, "Job: %s ready to be mined", current_job_id);
+}
+
+void current_job_flush()
+{
+    for (size_t i = 0; i < current_job_queue_count; i++)
+    {
+        delete current_job_queue[i];
+    }
+    current_job_queue_count = 0;
+}
+
+Job *current_job_dequeue()
+{
+    if (current_job_queue_count == 0)
+    {
+        return nullptr;
+    }
+    Job *job = current_job_queue[0];
+    current_job_queue_count--;
+    memmove(current_job_queue, current_job_queue + 1, sizeof(Job *) * current_job_queue_count);
+    return job;
+}
+
+void current_job_exhausted(uint32_t core)
+{
+    // Só pede a troca, quem publica é o lado da rede
+    const uint32_t epoch = current_worker_epoch[core];
+    current_job_exhausted_epoch = epoch;
+    current_job_release(core);
+}
+
+void current_job_service()
+{
+    // Pedido de um job que já foi trocado não conta
+    if (current_job_exhausted_epoch != current_epoch + 1 || current_job_queue_count == 0)
+    {
+        return;
+    }
+    l_info(TAG_CURRENT, "Job: %s exhausted, moving to the next queued one", current_job_id);
+    current_job_start(current_job_dequeue());
+}
+
+void current_job_invalidate()
+{
+    // O próximo da fila, se houver, senão os workers param até o próximo notify
+    Job *job = current_job_dequeue();
+    if (job != nullptr)
+    {
+        current_job_start(job);
+        return;
+    }
+    current_job_publish(nullptr);
+}
+
 void deleteCurrentJob()
 {
-    delete current_job;
-    current_job = nullptr;
+    current_job_publish(nullptr);
+}
+
+const char *current_getJobId()
+{
+    return current_job_id;
+}
+
+const uint32_t current_get_job_processed()
+{
+    return current_job_processed;
+}
+
+const char *current_getUptime()
+{
+    static char uptime[20];
+    const uint32_t seconds = millis() / 1000;
+    snprintf(uptime, sizeof(uptime), "%lud %02luh %02lum %02lus",
+             (unsigned long)(seconds / 86400), (unsigned long)(seconds / 3600 % 24),
+             (unsigned long)(seconds / 60 % 60), (unsigned long)(seconds % 60));
+    return uptime;
 }
 
 void current_resetSession()
 {
+    // The published job is kept, the miners stay on it until the new session sends a job.
+    // Its shares are dropped, the new session would reject them
     l_error(TAG_CURRENT, "Session reset");
+    current_session_epoch = current_epoch + 1;
     deleteCurrentSubscribe();
-    current_job_is_valid = 0;
-    deleteCurrentJob();
+    current_version_mask = 0;
+    current_job_flush();
 }
 
 void deleteCurrentSubscribe()
@@ -121,6 +343,7 @@ void current_setDifficulty(double difficulty)
     {
         l_info(TAG_CURRENT, "New difficulty: %.12f", difficulty);
         current_difficulty = difficulty;
+        current_share_target.fromDifficulty(difficulty);
     }
     catch (...)
     {
@@ -133,6 +356,55 @@ const double current_getDifficulty()
     return current_difficulty;
 }
 
+const uint8_t *current_getShareTarget()
+{
+    return current_share_target.value;
+}
+
+void current_setVersionMask(uint32_t version_mask)
+{
+    try
+    {
+        l_info(TAG_CURRENT, "Version mask: %08x", version_mask);
+        current_version_mask = version_mask;
+
+        // Jobs of an old session are replaced by the first notify of the new one, not rebuilt
+        if (!current_hasSessionJob())
+        {
+            return;
+        }
+
+        // Queued jobs have not been hashed yet, rebuild them with the new mask
+        for (size_t i = 0; i < current_job_queue_count; i++)
+        {
+            Job *job = current_job_queue[i];
+            if (job->version_mask != version_mask)
+            {
+                current_job_queue[i] = new Job(*job, version_mask);
+                delete job;
+            }
+        }
+
+        // The published job is republished in a new epoch, shares of the old one keep its mask in the history
+        const Job *job = current_jobs[current_epoch & 1];
+        if (job->version_mask != version_mask && !job->isExhausted())
+        {
+            l_debug(TAG_CURRENT, "Job: %s republished with the new version mask", current_job_id);
+            current_job_exhausted_epoch = 0;
+            current_job_publish(new Job(*job, version_mask));
+        }
+    }
+    catch (...)
+    {
+        handleException();
+    }
+}
+
+const uint32_t current_getVersionMask()
+{
+    return current_version_mask;
+}
+
 void current_increment_block_found()
 {
     current_block_found++;
@@ -208,41 +480,38 @@ const uint32_t current_get_hash_rejected()
     return current_hash_rejected;
 }
 
-void current_increment_hashes()
+void current_increment_hashes(uint32_t core, uint32_t hashes)
 {
-    try
+    // Single writer per counter, no lock and no clock read while hashing
+    current_worker_hashes[core].hashes = current_worker_hashes[core].hashes + hashes;
+}
+
+void current_stats_sample()
+{
+    const uint32_t now = millis();
+    const uint32_t elapsed = now - current_hashes_time;
+    if (elapsed < CURRENT_STATS_INTERVAL)
     {
-        if (current_hashes_time == 0)
-        {
-            current_hashes_time = millis();
-        }
-        current_hashes++;
+        return;
     }
-    catch (...)
+
+    uint32_t hashes = 0;
+    for (uint32_t core = 0; core < CORE; core++)
     {
-        handleException();
+        hashes += current_worker_hashes[core].hashes;
     }
-}
 
-void current_update_hashrate()
-{
-    try
+    // Counters wrap, only the difference since the last sample matters
+    if (current_hashes_time != 0)
     {
-        if (millis() - current_hashes_time > 1000)
-        {
-            current_hashrate = (current_hashes / ((millis() - current_hashes_time) / 1000.0)) / 1000.0; // KH/s
-            l_debug(TAG_CURRENT, "Hashrate: %.2f kH/s", current_hashrate);
+        current_hashrate = (hashes - current_hashes_sampled) / (double)elapsed; // kH/s
+        l_debug(TAG_CURRENT, "Hashrate: %.2f kH/s", current_hashrate);
 #if defined(HAS_LCD)
-            screen_loop();
+        screen_loop();
 #endif
-            current_hashes = 0;
-            current_hashes_time = millis();
-        }
-    }
-    catch (...)
-    {
-        handleException();
     }
+    current_hashes_sampled = hashes;
+    current_hashes_time = now;
 }
 
 void current_check_stale()
@@ -269,6 +538,7 @@ void handleException()
 
 void cleanupResources()
 {
+    current_job_flush();
     deleteCurrentJob();
     deleteCurrentSubscribe();
 }
@@ -283,4 +553,13 @@ void currentTaskFunction(void *pvParameters)
         vTaskDelay(CURRENT_STALE_TIMEOUT / portTICK_PERIOD_MS);
     }
 }
+
+void statsTaskFunction(void *pvParameters)
+{
+    while (1)
+    {
+        current_stats_sample();
+        vTaskDelay(CURRENT_STATS_INTERVAL / portTICK_PERIOD_MS);
+    }
+}
 #endif
@@ -6,20 +6,63 @@
 #include "model/notification.h"
 #include "model/configuration.h"
 
-extern Job *current_job;
-#if defined(ESP32)
-extern Job *current_job_next;
-#endif
-extern volatile bool current_job_is_valid;
+#define CURRENT_JOB_QUEUE_SIZE 2
+#define CURRENT_JOB_HISTORY 4 // Published jobs shares can still refer to
+#define CURRENT_CACHE_LINE 32
+#define CURRENT_STATS_INTERVAL 1000
+
+// What the network side needs to serialize a share of a published job
+struct current_job_info
+{
+    uint32_t epoch;
+    char job_id[NOTIFICATION_JOB_ID_SIZE + 1];
+    int extranonce2_size;
+    uint32_t version_mask;
+};
 
 void current_setJob(const Notification &notification);
+void current_job_invalidate();
+/**
+ * Takes the latest published job for the worker, called at every batch boundary.
+ * The job stays alive until the worker releases it or acquires again, may be null.
+ */
+Job *current_job_acquire(uint32_t core);
+/**
+ * Drops the worker's job, must be called before anything that can publish a new one (network calls).
+ */
+void current_job_release(uint32_t core);
+/**
+ * @return the epoch of the job the worker acquired, shares refer to their job by it.
+ */
+uint32_t current_job_epoch(uint32_t core);
+/**
+ * Network side: the job published in epoch, null if it is too old or there was no job.
+ */
+const current_job_info *current_job_lookup(uint32_t epoch);
+/**
+ * Releases the worker's job and asks the network side to move on to the next queued one.
+ */
+void current_job_exhausted(uint32_t core);
+/**
+ * Network side: publishes the next queued job once the current one is exhausted.
+ */
+void current_job_service();
+/**
+ * Jobs published before the last current_resetSession() belong to a dead session,
+ * their shares must not be submitted to the new one.
+ */
+bool current_job_in_session(uint32_t epoch);
 const char *current_getJobId();
+const uint32_t current_get_job_processed();
 const char *current_getUptime();
 void current_setSubscribe(Subscribe *subscribe);
 const char *current_getSessionId();
 void current_resetSession();
 void current_setDifficulty(double difficulty);
 const double current_getDifficulty();
+const uint8_t *current_getShareTarget();
+void current_setVersionMask(uint32_t version_mask);
+const uint32_t current_getVersionMask();
 void current_increment_block_found();
 const uint32_t current_get_block_found();
 const double current_get_hashrate();
@@ -30,14 +73,16 @@ const uint32_t current_get_hash_accepted();
 void current_increment_hash_rejected();
 const uint32_t current_get_hash_rejected();
 void current_increment_processedJob();
-void current_increment_hashes();
-void current_update_hashrate();
+void current_increment_hashes(uint32_t core, uint32_t hashes);
+void current_stats_sample();
 void current_check_stale();
 bool current_hasJob();
+bool current_hasSessionJob();
 
 // Declaration for ESP32 specific task function
 #if defined(ESP32)
 void currentTaskFunction(void *pvParameters);
+void statsTaskFunction(void *pvParameters);
 #endif
 
 #endif
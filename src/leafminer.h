@@ -7,5 +7,9 @@
 // Mining
 #define IS_NODE false
 #define MINING_MAX 0xffffffff
+#define MINING_BATCH_SIZE 1024
+#define MINING_YIELD_MS 33
+#define MINING_VERSION_ROLLING_MASK 0x1fffe000 // BIP 310, bits asked to the pool
+#define MINING_VERSION_ROLLING_MIN_BITS 2
 
 #endif
@@ -8,6 +8,8 @@
 #include "network/accesspoint.h"       // Funções para configurar o modo Access Point (AP)
 #include "utils/blink.h"               // Funções para piscar um LED, usado para feedback visual
 #include "miner/miner.h"               // Funções relacionadas à mineração
+#include "miner/engine.h"              // Registro das engines de hash e seleção no boot
+#include "miner/tuner.h"               // Calibração do lote e do intervalo de pausa do minerador
 #include "current.h"                   // Pode estar relacionado ao monitoramento de corrente ou tarefas correntes
 #include "utils/button.h"              // Funções para leitura e configuração de botões físicos
 #include "storage/storage.h"           // Funções para salvar e carregar dados em memória (eeprom, flash, etc.)
@@ -21,6 +23,9 @@
 // Tag usada para identificar as mensagens de log deste arquivo
 char TAG_MAIN[] = "Main";
 
+// Core das tarefas auxiliares (stale, stats, botões): o 1 no ESP32 dual core, o 0 nos single core
+#define MAIN_APP_CORE (CORE - 1)
+
 // Cria um objeto global de configuração
 Configuration configuration;
 
@@ -75,6 +80,12 @@ void setup() {
     #endif // MASS_WIFI_SSID
   }
 
+  // Testa as engines de hash com o vetor conhecido e escolhe a mais rápida
+  engine_setup();
+
+  // Na primeira vez calibra o tamanho do lote e o intervalo de pausa, depois usa o que foi salvo
+  tuner_setup(configuration);
+
   #if defined(HAS_LCD)
     // Se houver um LCD, inicializa a tela
     screen_setup();
@@ -103,19 +114,25 @@ void setup() {
 #if defined(ESP32)
   // Para ESP32, para o Bluetooth para liberar recursos
   btStop();
-  // Cria uma tarefa para monitorar a corrente (currentTaskFunction) e a fixa no Core 1
-  xTaskCreatePinnedToCore(currentTaskFunction, "stale", 1024, NULL, 1, NULL, 1);
-  // Cria uma tarefa para ler os botões, também no Core 1
-  xTaskCreatePinnedToCore(buttonTaskFunction, "button", 1024, NULL, 2, NULL, 1);
-  // Cria uma tarefa para a mineração no Core 1; o parâmetro (void *)0 indica que é a primeira instância
-  xTaskCreatePinnedToCore(mineTaskFunction, "miner0", 6000, (void *)0, 10, NULL, 1);
+  // Cria uma tarefa para monitorar a corrente (currentTaskFunction) no último core
+  xTaskCreatePinnedToCore(currentTaskFunction, "stale", 1024, NULL, 1, NULL, MAIN_APP_CORE);
+  // Cria uma tarefa de baixa prioridade que soma os contadores dos miners e calcula o hashrate.
+  // Nas placas com tela ela também redesenha o display, por isso a pilha do tamanho da dos miners
+  xTaskCreatePinnedToCore(statsTaskFunction, "stats", 6000, NULL, 2, NULL, MAIN_APP_CORE);
+  // Cria uma tarefa para ler os botões, também no último core
+  xTaskCreatePinnedToCore(buttonTaskFunction, "button", 1024, NULL, 2, NULL, MAIN_APP_CORE);
+  // A rede fica no Core 0, junto da pilha WiFi, e acorda por notificação quando há share para enviar
+  xTaskCreatePinnedToCore(networkTaskFunction, "network", 8192, NULL, 5, NULL, 0);
+  // Um miner por core, na menor prioridade: qualquer outra tarefa que acorde passa na frente
+  xTaskCreatePinnedToCore(mineTaskFunction, "miner0", 6000, (void *)0, 1, NULL, 0);
 #if CORE == 2
-  // Se o ESP32 tiver dois núcleos, cria uma segunda tarefa de mineração no outro núcleo (Core 1, mas com parâmetro (void *)1)
-  xTaskCreatePinnedToCore(mineTaskFunction, "miner1", 6000, (void *)1, 11, NULL, 1);
+  xTaskCreatePinnedToCore(mineTaskFunction, "miner1", 6000, (void *)1, 1, NULL, 1);
 #endif
+  // O loopTask do Arduino tem a mesma prioridade do miner1 e só giraria em vazio no loop(), tirando fatias dele
+  vTaskDelete(NULL);
 #elif defined(ESP8266)
-  // No ESP8266, que é unicore, inicia a função que escuta a rede (listener)
-  network_listen();
+  // No ESP8266, que é unicore, a rede avança entre os lotes do miner
+  network_loop();
 #endif
 }
 
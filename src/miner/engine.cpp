@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include "miner/engine.h"
+#include "model/target.h"
+#include "utils/utils.h"
+#include "utils/log.h"
+
+char TAG_ENGINE[] = "Engine";
+
+#define ENGINE_BENCH_NONCES 2048
+#define ENGINE_STR_(x) #x
+#define ENGINE_STR(x) ENGINE_STR_(x)
+
+// Engines registradas, a primeira é a referência usada enquanto engine_setup() não roda
+static const hash_engine engines[] = {
+    {"nerd", ENGINE_CAP_EARLY_EXIT, nerd_mids, nerd_sha256d_range},
+#if NERD_INTERLEAVE > 1
+    {"nerd-x" ENGINE_STR(NERD_INTERLEAVE), ENGINE_CAP_EARLY_EXIT | ENGINE_CAP_INTERLEAVED, nerd_mids, nerd_sha256d_range_interleaved},
+#endif
+};
+
+static const size_t engines_count = sizeof(engines) / sizeof(engines[0]);
+static const hash_engine *engine_selected = &engines[0];
+
+// Vetor conhecido: bloco 0000000000000000e067a478024addfecdc93628978aa52d91fabd4292982a50
+static const char *KAT_HEADER = "0200000017975b97c18ed1f7e255adf297599b55330edab87803c81701000000000000008a97295a2747b4f1a0b3948df3990344c0e19fa6b2b92b3a19c8e6badc141787358b0553535f011948750833";
+static const char *KAT_HASH = "0000000000000000e067a478024addfecdc93628978aa52d91fabd4292982a50";
+static const char *KAT_NBITS = "19015f53";
+static const uint32_t KAT_NONCE = 856192328;
+
+bool engine_self_test(const hash_engine *engine)
+{
+    uint8_t header[NERD_BITCOIN_BLOCK_SIZE];
+    uint8_t expected_hash[SHA256_HASH_SIZE];
+    hexStringToByteArray(KAT_HEADER, header);
+    stringToLittleEndianBytes(KAT_HASH, expected_hash);
+
+    Target target;
+    target.calculate(KAT_NBITS);
+
+    nerdSHA256_context ctx;
+    nerdSHA256_range_result result;
+    engine->init(&ctx, header);
+
+    // Sete nonces em volta do vencedor, a contagem ímpar não fecha uma volta inteira do kernel intercalado
+    const uint32_t scanned = engine->scan(&ctx, KAT_NONCE - 3, 7, target.value, &result);
+
+    return scanned == 7 && result.count == 1 && result.nonce[0] == KAT_NONCE &&
+           memcmp(result.hash[0], expected_hash, SHA256_HASH_SIZE) == 0;
+}
+
+static uint32_t engine_bench(const hash_engine *engine)
+{
+    uint8_t header[NERD_BITCOIN_BLOCK_SIZE];
+    hexStringToByteArray(KAT_HEADER, header);
+
+    // Target zero, nenhum hash passa e o range inteiro é varrido
+    const uint8_t target[SHA256_HASH_SIZE] = {};
+
+    nerdSHA256_context ctx;
+    nerdSHA256_range_result result;
+    engine->init(&ctx, header);
+
+    const uint32_t start = micros();
+    engine->scan(&ctx, 0, ENGINE_BENCH_NONCES, target, &result);
+    return micros() - start;
+}
+
+void engine_setup()
+{
+    const hash_engine *best = nullptr;
+    uint32_t best_time = UINT32_MAX;
+
+    for (size_t i = 0; i < engines_count; i++)
+    {
+        const hash_engine *engine = &engines[i];
+        if (!engine_self_test(engine))
+        {
+            l_error(TAG_ENGINE, "%s failed the self test, skipping", engine->name);
+            continue;
+        }
+
+        const uint32_t elapsed = engine_bench(engine);
+        l_info(TAG_ENGINE, "%s: %d hashes in %d us", engine->name, ENGINE_BENCH_NONCES, elapsed);
+        if (elapsed < best_time)
+        {
+            best = engine;
+            best_time = elapsed;
+        }
+    }
+
+    if (best == nullptr)
+    {
+        l_error(TAG_ENGINE, "No engine passed the self test, using %s", engines[0].name);
+        best = &engines[0];
+    }
+
+    engine_selected = best;
+    l_info(TAG_ENGINE, "Selected engine: %s", engine_selected->name);
+}
+
+const hash_engine *engine_get()
+{
+    return engine_selected;
+}
+
+const hash_engine *engine_list(size_t &count)
+{
+    count = engines_count;
+    return engines;
+}
@@ -0,0 +1,48 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "miner/nerdSHA256plus.h"
+
+#define ENGINE_CAP_EARLY_EXIT 0x01  // Returns only hashes that pass the 16-bit early exit
+#define ENGINE_CAP_INTERLEAVED 0x02 // Hashes several nonces per pass
+
+/**
+ * A hash engine scans a nonce range of a job.
+ * init prepares the midstate from the full 80 byte header, scan has the
+ * nerd_sha256d_range contract.
+ */
+struct hash_engine
+{
+    const char *name;
+    uint32_t caps;
+    void (*init)(nerdSHA256_context *ctx, uint8_t *header);
+    uint32_t (*scan)(nerdSHA256_context *ctx, uint32_t start_nonce, uint32_t count,
+                     const uint8_t *share_target, nerdSHA256_range_result *results);
+};
+
+/**
+ * Runs the known-answer test and a short timed run on every registered engine
+ * and selects the fastest one that passed.
+ */
+void engine_setup();
+
+/**
+ * Checks the engine against the known block header vector.
+ *
+ * @return true if the engine found the winning nonce with the expected hash.
+ */
+bool engine_self_test(const hash_engine *engine);
+
+/**
+ * @return the selected engine, the first registered one before engine_setup().
+ */
+const hash_engine *engine_get();
+
+/**
+ * @return the registered engines, count receives how many there are.
+ */
+const hash_engine *engine_list(size_t &count);
+
+#endif // ENGINE_H
@@ -4,78 +4,123 @@
 #include "current.h"
 #include "utils/log.h"
 #include "network/network.h"
-#if defined(HAS_LCD)
-#include "screen/screen.h"
-#endif
+#include "miner/tuner.h"
+#include "model/configuration.h"
 
 char TAG_MINER[] = "Miner";
 
-void miner(uint32_t core)
-{
+extern Configuration configuration;
 
-    if (!current_job_is_valid || current_job == nullptr) {
-        delay(100);
-        return;
-    }
+uint32_t miner_last_yield[2] = {0, 0};
 
-    double diff_hash = 0;
-    uint32_t winning_nonce = 0;
-    uint8_t hash[SHA256M_BLOCK_SIZE];
+/**
+ * Espera por um job novo. No ESP8266 não há tarefa de rede, então avança a rede aqui mesmo.
+ */
+void miner_idle()
+{
+#if defined(ESP8266)
+    network_loop();
+#endif
+    delay(100);  // Pequeno delay para não sobrecarregar o sistema
+}
 
-    std::string job_id;  // Cache o job_id
-    try {
-        job_id = current_job->job_id;  // Cache no início para evitar acesso durante o loop
-    } catch (...) {
-        l_error(TAG_MINER, "[%d] > Error accessing job_id", core);
-        return;
-    }
+void miner(uint32_t core)
+{
+    // Valores calibrados pelo tuner, ou os padrões enquanto não houver calibração
+    const uint32_t batch_size = configuration.batch_size > 0 ? configuration.batch_size : MINING_BATCH_SIZE;
+    const uint32_t yield_ms = configuration.yield_ms > 0 ? configuration.yield_ms : MINING_YIELD_MS;
 
+    nerdSHA256_range_result result;
+    result.count = 0;
 
-    while (current_job_is_valid)
+    while (result.count == 0)
     {
-        #if defined(ESP8266)
-                ESP.wdtFeed();
-        #endif
-        
-        if (!current_job) {
-            delay(100);  // Pequeno delay para não sobrecarregar o sistema
+        if (millis() - miner_last_yield[core] >= yield_ms)
+        {
+            tuner_yield();
+            miner_last_yield[core] = millis();
+#if !defined(ESP32)
+            // Sem tarefa de estatísticas no ESP8266, amostra aqui, fora do lote
+            current_stats_sample();
+#endif
+#if defined(ESP8266)
+            // Nem tarefa de rede: um passo da conexão por pausa, sem bloquear a mineração.
+            // O job é solto antes, a rede pode publicar outro
+            current_job_release(core);
+            network_loop();
+#endif
+        }
+
+        // Pega o job mais recente a cada lote, a troca de job não pausa a mineração
+        Job *job = current_job_acquire(core);
+        if (job == nullptr)
+        {
+            current_job_release(core);
+            miner_idle();
             return;
         }
 
-        current_increment_hashes();
+        // Varre um lote inteiro de nonces de uma vez, só voltam os hashes abaixo do share target
+        const uint32_t scanned = job->pickaxe(core, batch_size, current_getShareTarget(), result);
+        if (scanned == 0)
+        {
+            if (job->isExhausted())
+            {
+                // Acabou o espaço de extranonce2, pede o próximo job da fila
+                l_debug(TAG_MINER, "[%d] > Nothing left to mine, waiting for a new job", core);
+                current_job_exhausted(core);
+                network_wake();
+                miner_idle();
+            }
+            else
+            {
+                // Outro core está trocando o extranonce2, tenta de novo em seguida
+                current_job_release(core);
+            }
+            return;
+        }
+        current_increment_hashes(core, scanned);
 
-        if (!current_job->pickaxe(core, hash, winning_nonce))
+        if (result.count == 0)
         {
             continue;
         }
 
-        diff_hash = diff_from_target(hash);
-        if (diff_hash > current_getDifficulty())
+        // Copia o que o share precisa, o job só é garantido até o release
+        const std::string job_id = job->job_id;
+        Share share;
+        share.epoch = current_job_epoch(core);
+        share.extranonce2 = job->getExtranonce2Value(core);
+        share.ntime = job->block.ntime;
+        share.version_bits = job->getVersionBits(core);
+        bool found_block[NERD_RANGE_MAX_RESULTS];
+        for (uint32_t i = 0; i < result.count; i++)
         {
-            l_debug(TAG_MINER, "[%d] > Hash %.12f > %.12f", core, diff_hash, current_getDifficulty());
-            break;
+            found_block[i] = littleEndianCompare(result.hash[i], job->target.value, 32) < 0;
         }
-        current_update_hashrate();
-    }
 
-        #if defined(HAS_LCD)
-            screen_loop();
-        #endif // HAS_LCD
+        // O job é solto antes de falar com a rede
+        current_job_release(core);
 
-        if (current_job_is_valid && current_job != nullptr) {  // Verifique novamente
-            l_info(TAG_MINER, "[%d] > [%s] > 0x%.8x - diff %.12f", 
-                core, job_id.c_str(), winning_nonce, diff_hash);
-            network_send(job_id, current_job->extranonce2, current_job->ntime, winning_nonce);
-        }
+        for (uint32_t i = 0; i < result.count; i++)
+        {
+            // A dificuldade em double só é calculada para os shares que vão ser enviados
+            const double diff_hash = diff_from_target(result.hash[i]);
+            l_debug(TAG_MINER, "[%d] > Hash %.12f > %.12f", core, diff_hash, current_getDifficulty());
 
-    network_send(current_job->job_id, current_job->extranonce2, current_job->ntime, winning_nonce);
+            l_info(TAG_MINER, "[%d] > [%s] > 0x%.8x - diff %.12f",
+                core, job_id.c_str(), result.nonce[i], diff_hash);
+            share.nonce = result.nonce[i];
+            network_send(core, share);
 
-    current_setHighestDifficulty(diff_hash);
+            current_setHighestDifficulty(diff_hash);
 
-    if (littleEndianCompare(hash, current_job->target.value, 32) < 0)
-    {
-        l_info(TAG_MINER, "[%d] > Found block - 0x%.8x", core, current_job->block.nonce);
-        current_increment_block_found();
+            if (found_block[i])
+            {
+                l_info(TAG_MINER, "[%d] > Found block - 0x%.8x", core, result.nonce[i]);
+                current_increment_block_found();
+            }
+        }
     }
 }
 
@@ -83,10 +128,10 @@ void miner(uint32_t core)
 void mineTaskFunction(void *pvParameters)
 {
     uint32_t core = (uint32_t)pvParameters;
-    while (current_job_is_valid)
+    while (1)
     {
         miner(core);
-        vTaskDelay(33 / portTICK_PERIOD_MS); // Add a small delay to prevent tight loop
+        vTaskDelay(1); // O ritmo fica com o yield_ms calibrado, aqui só evita um loop apertado
     }
 }
 #endif
@@ -93,7 +93,7 @@ MEM_ATTR static const uint32_t K[64] = {
  * 
  * Por fim, o operador OR (|) junta os dois resultados, obtendo a rotação completa.
  */
-inline uint32_t ROTR(uint32_t x, uint32_t n)
+constexpr inline uint32_t ROTR(uint32_t x, uint32_t n)
 {
     return ((x >> n) | (x << ((sizeof(x) << 3) - n)));
 }
@@ -202,7 +202,7 @@ inline uint32_t GET_UINT32_BE(const uint8_t *b, uint32_t i)
     Resultado:
       Portanto, SHR(0x12345678, 4) retorna 0x01234567.
  */
-inline uint32_t SHR(uint32_t x, uint32_t n)
+constexpr inline uint32_t SHR(uint32_t x, uint32_t n)
 {
     return ((x & 0xFFFFFFFF) >> n);
 }
@@ -212,19 +212,19 @@ inline uint32_t SHR(uint32_t x, uint32_t n)
  * Estas funções realizam rotações e deslocamentos e são cruciais para a “difusão” 
  * dos bits durante a compressão.
  */
-inline uint32_t S0(uint32_t x)
+constexpr inline uint32_t S0(uint32_t x)
 {
     return (ROTR(x, 7) ^ ROTR(x, 18) ^ SHR(x, 3));
 }
-inline uint32_t S1(uint32_t x)
+constexpr inline uint32_t S1(uint32_t x)
 {
     return (ROTR(x, 17) ^ ROTR(x, 19) ^ SHR(x, 10));
 }
-inline uint32_t S2(uint32_t x)
+constexpr inline uint32_t S2(uint32_t x)
 {
     return (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22));
 }
-inline uint32_t S3(uint32_t x)
+constexpr inline uint32_t S3(uint32_t x)
 {
     return (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25));
 }
@@ -256,7 +256,7 @@ inline uint32_t S3(uint32_t x)
         h = temp1 + temp2;                       \
     }
 
-RAM_ATTR void nerd_mids(nerdSHA256_context *midstate, uint8_t dataIn[NERD_SHA256_BLOCK_SIZE])
+RAM_ATTR void nerd_mids(nerdSHA256_context *midstate, uint8_t dataIn[NERD_BITCOIN_BLOCK_SIZE])
 {
     uint32_t A[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
 
@@ -352,22 +352,77 @@ RAM_ATTR void nerd_mids(nerdSHA256_context *midstate, uint8_t dataIn[NERD_SHA256
     midstate->digest[5] = 0x9B05688C + A[5];
     midstate->digest[6] = 0x1F83D9AB + A[6];
     midstate->digest[7] = 0x5BE0CD19 + A[7];
-}
 
-RAM_ATTR uint8_t nerd_sha256d(nerdSHA256_context *midstate, uint8_t dataIn[NERD_JOB_BLOCK_SIZE], uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE])
-{
-    uint32_t temp1, temp2;
+    /* Second block: merkle tail, ntime and nbits don't change with the nonce,
+       so rounds 0-2, half of round 3 and the fixed parts of W16-W19 are done here once per job */
+    W[0] = GET_UINT32_BE(dataIn, 64);
+    W[1] = GET_UINT32_BE(dataIn, 68);
+    W[2] = GET_UINT32_BE(dataIn, 72);
 
-    //*********** Init 1rst SHA ***********
+    for (int i = 0; i < 8; i++)
+    {
+        A[i] = midstate->digest[i];
+    }
+
+    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[0], K[0]);
+    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[1], K[1]);
+    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[2], K[2]);
+
+    for (int i = 0; i < 8; i++)
+    {
+        midstate->tail_state[i] = A[i];
+    }
+    // Round 3 without the nonce: temp1 = tail_t1 + W3, temp2 = tail_t2
+    midstate->tail_t1 = A[4] + S3(A[1]) + F1(A[1], A[2], A[3]) + K[3];
+    midstate->tail_t2 = S2(A[5]) + F0(A[5], A[6], A[7]);
+
+    // W4 = 0x80000000, W5-W14 = 0, W15 = 640
+    midstate->tail_w[0] = S0(W[1]) + W[0];                           // W16
+    midstate->tail_w[1] = S1(640) + S0(W[2]) + W[1];                 // W17
+    midstate->tail_w[2] = S1(midstate->tail_w[0]) + W[2];            // W18 - S0(W3)
+    midstate->tail_w[3] = S1(midstate->tail_w[1]) + S0(0x80000000); // W19 - W3
+}
 
-    uint32_t W[64] = {GET_UINT32_BE(dataIn, 0), GET_UINT32_BE(dataIn, 4),
-                      GET_UINT32_BE(dataIn, 8), GET_UINT32_BE(dataIn, 12), 0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                      0, 640};
+/**
+ * Constantes do segundo SHA (outer) do sha256d: a mensagem é sempre o digest de 32 bytes
+ * seguido do padding fixo, então W8 = 0x80000000, W9-W14 = 0 e W15 = 256.
+ * Tudo que depende só dessas palavras é resolvido em tempo de compilação.
+ */
+static constexpr uint32_t OUTER_W8 = 0x80000000;
+static constexpr uint32_t OUTER_W15 = 256;
+static constexpr uint32_t OUTER_S1_W15 = S1(OUTER_W15);
+static constexpr uint32_t OUTER_S0_W8 = S0(OUTER_W8);
+static constexpr uint32_t OUTER_S0_W15 = S0(OUTER_W15);
+// Rodada 0 parte sempre do IV, só W0 varia
+static constexpr uint32_t OUTER_T1_0 = 0x5BE0CD19 + S3(0x510E527F) + F1(0x510E527F, 0x9B05688C, 0x1F83D9AB) + 0x428A2F98;
+static constexpr uint32_t OUTER_T2_0 = S2(0x6A09E667) + F0(0x6A09E667, 0xBB67AE85, 0x3C6EF372);
 
-    uint32_t A[8] = {midstate->digest[0], midstate->digest[1], midstate->digest[2], midstate->digest[3],
-                     midstate->digest[4], midstate->digest[5], midstate->digest[6], midstate->digest[7]};
+/**
+ * Rodada de compressão com K + W já somados (usada nas rodadas 8-15 do outer, onde W é constante).
+ */
+#define PK(a, b, c, d, e, f, g, h, KW)          \
+    {                                           \
+        temp1 = h + S3(e) + F1(e, f, g) + (KW); \
+        temp2 = S2(a) + F0(a, b, c);            \
+        d += temp1;                             \
+        h = temp1 + temp2;                      \
+    }
 
-    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[0], K[0]);
+/**
+ * Segundo SHA-256 do sha256d, especializado para a entrada de 32 bytes.
+ * O schedule W16-W31 usa as formas já simplificadas (termos zero removidos, constantes dobradas)
+ * e o estado fica em variáveis locais com índice constante, que o compilador mantém em registradores.
+ * Mantém o early exit em doubleHash[31]/[30] antes das três últimas rodadas.
+ */
+static inline __attribute__((always_inline)) uint8_t nerd_outer_hash(const uint32_t digest[8], uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE])
+{
+    uint32_t temp1, temp2;
+    uint32_t W[64] = {digest[0], digest[1], digest[2], digest[3], digest[4], digest[5], digest[6], digest[7]};
+    uint32_t A[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+    temp1 = OUTER_T1_0 + W[0];
+    A[3] += temp1;
+    A[7] = temp1 + OUTER_T2_0;
     P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[1], K[1]);
     P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[2], K[2]);
     P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[3], K[3]);
@@ -375,30 +430,46 @@ RAM_ATTR uint8_t nerd_sha256d(nerdSHA256_context *midstate, uint8_t dataIn[NERD_
     P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[5], K[5]);
     P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[6], K[6]);
     P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[7], K[7]);
-    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[8], K[8]);
-    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[9], K[9]);
-    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[10], K[10]);
-    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[11], K[11]);
-    P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], W[12], K[12]);
-    P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[13], K[13]);
-    P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[14], K[14]);
-    P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[15], K[15]);
-    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], R(16), K[16]);
-    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], R(17), K[17]);
-    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], R(18), K[18]);
-    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], R(19), K[19]);
-    P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], R(20), K[20]);
-    P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], R(21), K[21]);
-    P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], R(22), K[22]);
-    P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], R(23), K[23]);
-    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], R(24), K[24]);
-    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], R(25), K[25]);
-    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], R(26), K[26]);
-    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], R(27), K[27]);
-    P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], R(28), K[28]);
-    P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], R(29), K[29]);
-    P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], R(30), K[30]);
-    P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], R(31), K[31]);
+    PK(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 0xD807AA98 + OUTER_W8);
+    PK(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 0x12835B01);
+    PK(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 0x243185BE);
+    PK(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 0x550C7DC3);
+    PK(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 0x72BE5D74);
+    PK(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 0x80DEB1FE);
+    PK(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 0x9BDC06A7);
+    PK(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 0xC19BF174 + OUTER_W15);
+    W[16] = S0(W[1]) + W[0];
+    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[16], K[16]);
+    W[17] = OUTER_S1_W15 + S0(W[2]) + W[1];
+    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[17], K[17]);
+    W[18] = S1(W[16]) + S0(W[3]) + W[2];
+    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[18], K[18]);
+    W[19] = S1(W[17]) + S0(W[4]) + W[3];
+    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[19], K[19]);
+    W[20] = S1(W[18]) + S0(W[5]) + W[4];
+    P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], W[20], K[20]);
+    W[21] = S1(W[19]) + S0(W[6]) + W[5];
+    P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[21], K[21]);
+    W[22] = S1(W[20]) + OUTER_W15 + S0(W[7]) + W[6];
+    P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[22], K[22]);
+    W[23] = S1(W[21]) + W[16] + OUTER_S0_W8 + W[7];
+    P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[23], K[23]);
+    W[24] = S1(W[22]) + W[17] + OUTER_W8;
+    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[24], K[24]);
+    W[25] = S1(W[23]) + W[18];
+    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[25], K[25]);
+    W[26] = S1(W[24]) + W[19];
+    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[26], K[26]);
+    W[27] = S1(W[25]) + W[20];
+    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[27], K[27]);
+    W[28] = S1(W[26]) + W[21];
+    P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], W[28], K[28]);
+    W[29] = S1(W[27]) + W[22];
+    P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[29], K[29]);
+    W[30] = S1(W[28]) + W[23] + OUTER_S0_W15;
+    P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[30], K[30]);
+    W[31] = S1(W[29]) + W[24] + S0(W[16]) + OUTER_W15;
+    P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[31], K[31]);
     P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], R(32), K[32]);
     P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], R(33), K[33]);
     P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], R(34), K[34]);
@@ -428,44 +499,55 @@ RAM_ATTR uint8_t nerd_sha256d(nerdSHA256_context *midstate, uint8_t dataIn[NERD_
     P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], R(58), K[58]);
     P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], R(59), K[59]);
     P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], R(60), K[60]);
+
+    // At this stage we can already figure out how many zeros we have at the end of the hash
+    // and we can check if the hash is a valid block hash. This is called early exit optimisation.
+    PUT_UINT32_BE(0x5BE0CD19 + A[7], doubleHash, 28);
+    if (doubleHash[31] != 0 || doubleHash[30] != 0)
+    {
+        return 0;
+    }
+
     P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], R(61), K[61]);
     P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], R(62), K[62]);
     P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], R(63), K[63]);
 
-    //*********** end SHA_finish ***********
+    PUT_UINT32_BE(0x6A09E667 + A[0], doubleHash, 0);
+    PUT_UINT32_BE(0xBB67AE85 + A[1], doubleHash, 4);
+    PUT_UINT32_BE(0x3C6EF372 + A[2], doubleHash, 8);
+    PUT_UINT32_BE(0xA54FF53A + A[3], doubleHash, 12);
+    PUT_UINT32_BE(0x510E527F + A[4], doubleHash, 16);
+    PUT_UINT32_BE(0x9B05688C + A[5], doubleHash, 20);
+    PUT_UINT32_BE(0x1F83D9AB + A[6], doubleHash, 24);
 
-    /* Calculate the second hash (double SHA-256) */
+    return 1;
+}
 
-    W[0] = A[0] + midstate->digest[0];
-    W[1] = A[1] + midstate->digest[1];
-    W[2] = A[2] + midstate->digest[2];
-    W[3] = A[3] + midstate->digest[3];
-    W[4] = A[4] + midstate->digest[4];
-    W[5] = A[5] + midstate->digest[5];
-    W[6] = A[6] + midstate->digest[6];
-    W[7] = A[7] + midstate->digest[7];
-    W[8] = 0x80000000;
-    W[9] = 0;
-    W[10] = 0;
-    W[11] = 0;
-    W[12] = 0;
-    W[13] = 0;
-    W[14] = 0;
-    W[15] = 256;
-
-    A[0] = 0x6A09E667;
-    A[1] = 0xBB67AE85;
-    A[2] = 0x3C6EF372;
-    A[3] = 0xA54FF53A;
-    A[4] = 0x510E527F;
-    A[5] = 0x9B05688C;
-    A[6] = 0x1F83D9AB;
-    A[7] = 0x5BE0CD19;
+/**
+ * Núcleo do sha256d sobre o segundo bloco (cauda de 16 bytes + padding) a partir do midstate.
+ * É forçado inline para que nerd_sha256d_range() tenha um único laço apertado, sem chamada por nonce.
+ * As rodadas 0-2 e o schedule fixo vêm prontos do nerd_mids(), então só o nonce (w3, big-endian) entra aqui
+ * e a compressão começa na rodada 3.
+ */
+static inline __attribute__((always_inline)) uint8_t nerd_double_hash(const nerdSHA256_context *midstate, uint32_t w3, uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE])
+{
+    uint32_t temp1, temp2;
+
+    //*********** Init 1rst SHA ***********
+
+    // W0-W2 já foram consumidos pelas rodadas pré-calculadas e não são mais lidos
+    uint32_t W[64] = {0, 0, 0, w3, 0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                      0, 640, midstate->tail_w[0], midstate->tail_w[1],
+                      midstate->tail_w[2] + S0(w3), midstate->tail_w[3] + w3};
+
+    uint32_t A[8] = {midstate->tail_state[0], midstate->tail_state[1], midstate->tail_state[2], midstate->tail_state[3],
+                     midstate->tail_state[4], midstate->tail_state[5], midstate->tail_state[6], midstate->tail_state[7]};
+
+    // Rodada 3: só a parte que depende do nonce
+    temp1 = midstate->tail_t1 + w3;
+    A[0] += temp1;
+    A[4] = temp1 + midstate->tail_t2;
 
-    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[0], K[0]);
-    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[1], K[1]);
-    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[2], K[2]);
-    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[3], K[3]);
     P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], W[4], K[4]);
     P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[5], K[5]);
     P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[6], K[6]);
@@ -478,10 +560,10 @@ RAM_ATTR uint8_t nerd_sha256d(nerdSHA256_context *midstate, uint8_t dataIn[NERD_
     P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[13], K[13]);
     P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[14], K[14]);
     P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[15], K[15]);
-    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], R(16), K[16]);
-    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], R(17), K[17]);
-    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], R(18), K[18]);
-    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], R(19), K[19]);
+    P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[16], K[16]);
+    P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[17], K[17]);
+    P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[18], K[18]);
+    P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[19], K[19]);
     P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], R(20), K[20]);
     P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], R(21), K[21]);
     P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], R(22), K[22]);
@@ -523,26 +605,390 @@ RAM_ATTR uint8_t nerd_sha256d(nerdSHA256_context *midstate, uint8_t dataIn[NERD_
     P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], R(58), K[58]);
     P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], R(59), K[59]);
     P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], R(60), K[60]);
+    P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], R(61), K[61]);
+    P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], R(62), K[62]);
+    P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], R(63), K[63]);
 
-    // At this stage we can already figure out how many zeros we have at the end of the hash
-    // and we can check if the hash is a valid block hash. This is called early exit optimisation.
-    PUT_UINT32_BE(0x5BE0CD19 + A[7], doubleHash, 28);
-    if (doubleHash[31] != 0 || doubleHash[30] != 0)
+    //*********** end SHA_finish ***********
+
+    /* Calculate the second hash (double SHA-256) */
+
+    uint32_t digest[8] = {A[0] + midstate->digest[0], A[1] + midstate->digest[1], A[2] + midstate->digest[2], A[3] + midstate->digest[3],
+                          A[4] + midstate->digest[4], A[5] + midstate->digest[5], A[6] + midstate->digest[6], A[7] + midstate->digest[7]};
+
+    return nerd_outer_hash(digest, doubleHash);
+}
+
+RAM_ATTR uint8_t nerd_sha256d(nerdSHA256_context *midstate, uint8_t dataIn[NERD_JOB_BLOCK_SIZE], uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE])
+{
+    return nerd_double_hash(midstate, GET_UINT32_BE(dataIn, 12), doubleHash);
+}
+
+#if defined(UNIT_TEST)
+/**
+ * Compressão genérica de um bloco: as 64 rodadas com P e R, sem nada pré-calculado.
+ */
+static void nerd_generic_compress(uint32_t state[8], uint32_t W[64])
+{
+    uint32_t temp1, temp2;
+    uint32_t A[8] = {state[0], state[1], state[2], state[3], state[4], state[5], state[6], state[7]};
+
+    for (int t = 0; t < 64; t += 8)
+    {
+        P(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], (t < 16 ? W[t] : R(t)), K[t]);
+        P(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], (t < 16 ? W[t + 1] : R(t + 1)), K[t + 1]);
+        P(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], (t < 16 ? W[t + 2] : R(t + 2)), K[t + 2]);
+        P(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], (t < 16 ? W[t + 3] : R(t + 3)), K[t + 3]);
+        P(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], (t < 16 ? W[t + 4] : R(t + 4)), K[t + 4]);
+        P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], (t < 16 ? W[t + 5] : R(t + 5)), K[t + 5]);
+        P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], (t < 16 ? W[t + 6] : R(t + 6)), K[t + 6]);
+        P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], (t < 16 ? W[t + 7] : R(t + 7)), K[t + 7]);
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        state[i] += A[i];
+    }
+}
+
+uint8_t nerd_sha256d_generic(nerdSHA256_context *midstate, uint8_t dataIn[NERD_JOB_BLOCK_SIZE], uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE])
+{
+    // Segundo bloco do header a partir do digest do primeiro, todas as rodadas
+    uint32_t state[8] = {midstate->digest[0], midstate->digest[1], midstate->digest[2], midstate->digest[3],
+                         midstate->digest[4], midstate->digest[5], midstate->digest[6], midstate->digest[7]};
+    uint32_t W[64] = {GET_UINT32_BE(dataIn, 0), GET_UINT32_BE(dataIn, 4), GET_UINT32_BE(dataIn, 8), GET_UINT32_BE(dataIn, 12),
+                      0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 640};
+    nerd_generic_compress(state, W);
+
+    // SHA-256 do digest de 32 bytes, com o padding completo
+    uint32_t outer[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+    uint32_t W2[64] = {state[0], state[1], state[2], state[3], state[4], state[5], state[6], state[7],
+                       0x80000000, 0, 0, 0, 0, 0, 0, 256};
+    nerd_generic_compress(outer, W2);
+
+    for (int i = 0; i < 8; i++)
+    {
+        PUT_UINT32_BE(outer[i], doubleHash, i * 4);
+    }
+    return doubleHash[31] == 0 && doubleHash[30] == 0;
+}
+#endif // UNIT_TEST
+
+/**
+ * Compara o hash (little-endian de 256 bits) com o target, do byte mais significativo para o menos.
+ * Só é chamada para os poucos candidatos que passam pelo early exit de 16 bits.
+ */
+static inline bool nerd_below_target(const uint8_t hash[SHA256_HASH_SIZE], const uint8_t target[SHA256_HASH_SIZE])
+{
+    for (int i = SHA256_HASH_SIZE - 1; i >= 0; i--)
+    {
+        if (hash[i] != target[i])
+        {
+            return hash[i] < target[i];
+        }
+    }
+    return true;
+}
+
+RAM_ATTR uint32_t nerd_sha256d_range(nerdSHA256_context *midstate, uint32_t start_nonce, uint32_t count, const uint8_t share_target[SHA256_HASH_SIZE], nerdSHA256_range_result *results)
+{
+    uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE];
+
+    results->count = 0;
+
+    uint32_t nonce = start_nonce;
+    uint32_t scanned = 0;
+    while (scanned < count)
+    {
+        // O nonce fica em little-endian no header, mas entra no SHA como word big-endian
+        const uint8_t found = nerd_double_hash(midstate, __builtin_bswap32(nonce), doubleHash);
+        scanned++;
+
+        if (found && (share_target == nullptr || nerd_below_target(doubleHash, share_target)))
+        {
+            results->nonce[results->count] = nonce;
+            memcpy(results->hash[results->count], doubleHash, SHA256_HASH_SIZE);
+            if (++results->count == NERD_RANGE_MAX_RESULTS)
+            {
+                break;
+            }
+        }
+        nonce++;
+    }
+
+    return scanned;
+}
+
+#if NERD_INTERLEAVE > 1
+/**
+ * Kernel intercalado: NERD_INTERLEAVE nonces independentes passam juntos por cada rodada.
+ * Cada macro abaixo repete a rodada para todas as lanes, assim as cadeias de dependência
+ * de nonces diferentes ficam lado a lado e o compilador pode sobrepor as latências.
+ * Código C++ puro, compila igual no Xtensa e no host (env:native).
+ */
+#define PN(a, b, c, d, e, f, g, h, x, K)                                              \
+    for (int l = 0; l < NERD_INTERLEAVE; l++)                                         \
+    {                                                                                 \
+        P(a[l], b[l], c[l], d[l], e[l], f[l], g[l], h[l], x, K);                      \
+    }
+
+#define PKN(a, b, c, d, e, f, g, h, KW)                                               \
+    for (int l = 0; l < NERD_INTERLEAVE; l++)                                         \
+    {                                                                                 \
+        PK(a[l], b[l], c[l], d[l], e[l], f[l], g[l], h[l], KW);                       \
+    }
+
+#define PWN(a, b, c, d, e, f, g, h, t, w, K)                                          \
+    for (int l = 0; l < NERD_INTERLEAVE; l++)                                         \
+    {                                                                                 \
+        W[t][l] = w;                                                                  \
+        P(a[l], b[l], c[l], d[l], e[l], f[l], g[l], h[l], W[t][l], K);                \
+    }
+
+#define PRN(a, b, c, d, e, f, g, h, t, K)                                             \
+    PWN(a, b, c, d, e, f, g, h, t, S1(W[t - 2][l]) + W[t - 7][l] + S0(W[t - 15][l]) + W[t - 16][l], K)
+
+/**
+ * sha256d de NERD_INTERLEAVE nonces de uma vez. Retorna uma máscara com as lanes que passaram
+ * pelo early exit, só essas têm o doubleHash completo.
+ */
+static inline __attribute__((always_inline)) uint32_t nerd_double_hash_lanes(const nerdSHA256_context *midstate, const uint32_t w3[NERD_INTERLEAVE], uint8_t doubleHash[NERD_INTERLEAVE][NERD_SHA256_BLOCK_SIZE])
+{
+    uint32_t temp1, temp2;
+    uint32_t W[64][NERD_INTERLEAVE];
+    uint32_t A[8][NERD_INTERLEAVE];
+
+    //*********** Init 1rst SHA ***********
+
+    for (int l = 0; l < NERD_INTERLEAVE; l++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            A[i][l] = midstate->tail_state[i];
+        }
+        W[3][l] = w3[l];
+        W[4][l] = 0x80000000;
+        for (int i = 5; i < 15; i++)
+        {
+            W[i][l] = 0;
+        }
+        W[15][l] = 640;
+        W[16][l] = midstate->tail_w[0];
+        W[17][l] = midstate->tail_w[1];
+
+        // Rodada 3: só a parte que depende do nonce
+        temp1 = midstate->tail_t1 + w3[l];
+        A[0][l] += temp1;
+        A[4][l] = temp1 + midstate->tail_t2;
+    }
+
+    PN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 0x80000000, K[4]);
+    PN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 0, K[5]);
+    PN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 0, K[6]);
+    PN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 0, K[7]);
+    PN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 0, K[8]);
+    PN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 0, K[9]);
+    PN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 0, K[10]);
+    PN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 0, K[11]);
+    PN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 0, K[12]);
+    PN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 0, K[13]);
+    PN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 0, K[14]);
+    PN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 640, K[15]);
+    PN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], midstate->tail_w[0], K[16]);
+    PN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], midstate->tail_w[1], K[17]);
+    PWN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 18, midstate->tail_w[2] + S0(W[3][l]), K[18]);
+    PWN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 19, midstate->tail_w[3] + W[3][l], K[19]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 20, K[20]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 21, K[21]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 22, K[22]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 23, K[23]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 24, K[24]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 25, K[25]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 26, K[26]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 27, K[27]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 28, K[28]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 29, K[29]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 30, K[30]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 31, K[31]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 32, K[32]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 33, K[33]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 34, K[34]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 35, K[35]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 36, K[36]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 37, K[37]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 38, K[38]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 39, K[39]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 40, K[40]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 41, K[41]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 42, K[42]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 43, K[43]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 44, K[44]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 45, K[45]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 46, K[46]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 47, K[47]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 48, K[48]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 49, K[49]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 50, K[50]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 51, K[51]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 52, K[52]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 53, K[53]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 54, K[54]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 55, K[55]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 56, K[56]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 57, K[57]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 58, K[58]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 59, K[59]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 60, K[60]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 61, K[61]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 62, K[62]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 63, K[63]);
+
+    //*********** end SHA_finish ***********
+
+    /* Calculate the second hash (double SHA-256) */
+
+    for (int l = 0; l < NERD_INTERLEAVE; l++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            W[i][l] = A[i][l] + midstate->digest[i];
+        }
+        A[0][l] = 0x6A09E667;
+        A[1][l] = 0xBB67AE85;
+        A[2][l] = 0x3C6EF372;
+        A[3][l] = 0xA54FF53A + OUTER_T1_0 + W[0][l];
+        A[4][l] = 0x510E527F;
+        A[5][l] = 0x9B05688C;
+        A[6][l] = 0x1F83D9AB;
+        A[7][l] = OUTER_T1_0 + W[0][l] + OUTER_T2_0;
+    }
+
+    PN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[1][l], K[1]);
+    PN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[2][l], K[2]);
+    PN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[3][l], K[3]);
+    PN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], W[4][l], K[4]);
+    PN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[5][l], K[5]);
+    PN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[6][l], K[6]);
+    PN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[7][l], K[7]);
+    PKN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 0xD807AA98 + OUTER_W8);
+    PKN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 0x12835B01);
+    PKN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 0x243185BE);
+    PKN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 0x550C7DC3);
+    PKN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 0x72BE5D74);
+    PKN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 0x80DEB1FE);
+    PKN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 0x9BDC06A7);
+    PKN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 0xC19BF174 + OUTER_W15);
+    PWN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 16, S0(W[1][l]) + W[0][l], K[16]);
+    PWN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 17, OUTER_S1_W15 + S0(W[2][l]) + W[1][l], K[17]);
+    PWN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 18, S1(W[16][l]) + S0(W[3][l]) + W[2][l], K[18]);
+    PWN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 19, S1(W[17][l]) + S0(W[4][l]) + W[3][l], K[19]);
+    PWN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 20, S1(W[18][l]) + S0(W[5][l]) + W[4][l], K[20]);
+    PWN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 21, S1(W[19][l]) + S0(W[6][l]) + W[5][l], K[21]);
+    PWN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 22, S1(W[20][l]) + OUTER_W15 + S0(W[7][l]) + W[6][l], K[22]);
+    PWN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 23, S1(W[21][l]) + W[16][l] + OUTER_S0_W8 + W[7][l], K[23]);
+    PWN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 24, S1(W[22][l]) + W[17][l] + OUTER_W8, K[24]);
+    PWN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 25, S1(W[23][l]) + W[18][l], K[25]);
+    PWN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 26, S1(W[24][l]) + W[19][l], K[26]);
+    PWN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 27, S1(W[25][l]) + W[20][l], K[27]);
+    PWN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 28, S1(W[26][l]) + W[21][l], K[28]);
+    PWN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 29, S1(W[27][l]) + W[22][l], K[29]);
+    PWN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 30, S1(W[28][l]) + W[23][l] + OUTER_S0_W15, K[30]);
+    PWN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 31, S1(W[29][l]) + W[24][l] + S0(W[16][l]) + OUTER_W15, K[31]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 32, K[32]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 33, K[33]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 34, K[34]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 35, K[35]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 36, K[36]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 37, K[37]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 38, K[38]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 39, K[39]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 40, K[40]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 41, K[41]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 42, K[42]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 43, K[43]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 44, K[44]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 45, K[45]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 46, K[46]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 47, K[47]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 48, K[48]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 49, K[49]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 50, K[50]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 51, K[51]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 52, K[52]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 53, K[53]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 54, K[54]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 55, K[55]);
+    PRN(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], 56, K[56]);
+    PRN(A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], 57, K[57]);
+    PRN(A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], 58, K[58]);
+    PRN(A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], 59, K[59]);
+    PRN(A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], 60, K[60]);
+
+    // Early exit por lane, as três últimas rodadas só rodam se alguma lane passou
+    uint32_t found = 0;
+    for (int l = 0; l < NERD_INTERLEAVE; l++)
+    {
+        PUT_UINT32_BE(0x5BE0CD19 + A[7][l], doubleHash[l], 28);
+        if (doubleHash[l][31] == 0 && doubleHash[l][30] == 0)
+        {
+            found |= 1 << l;
+        }
+    }
+    if (found == 0)
     {
         return 0;
     }
 
-    P(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], R(61), K[61]);
-    P(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], R(62), K[62]);
-    P(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], R(63), K[63]);
+    PRN(A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], 61, K[61]);
+    PRN(A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], 62, K[62]);
+    PRN(A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], 63, K[63]);
 
-    PUT_UINT32_BE(0x6A09E667 + A[0], doubleHash, 0);
-    PUT_UINT32_BE(0xBB67AE85 + A[1], doubleHash, 4);
-    PUT_UINT32_BE(0x3C6EF372 + A[2], doubleHash, 8);
-    PUT_UINT32_BE(0xA54FF53A + A[3], doubleHash, 12);
-    PUT_UINT32_BE(0x510E527F + A[4], doubleHash, 16);
-    PUT_UINT32_BE(0x9B05688C + A[5], doubleHash, 20);
-    PUT_UINT32_BE(0x1F83D9AB + A[6], doubleHash, 24);
+    for (int l = 0; l < NERD_INTERLEAVE; l++)
+    {
+        PUT_UINT32_BE(0x6A09E667 + A[0][l], doubleHash[l], 0);
+        PUT_UINT32_BE(0xBB67AE85 + A[1][l], doubleHash[l], 4);
+        PUT_UINT32_BE(0x3C6EF372 + A[2][l], doubleHash[l], 8);
+        PUT_UINT32_BE(0xA54FF53A + A[3][l], doubleHash[l], 12);
+        PUT_UINT32_BE(0x510E527F + A[4][l], doubleHash[l], 16);
+        PUT_UINT32_BE(0x9B05688C + A[5][l], doubleHash[l], 20);
+        PUT_UINT32_BE(0x1F83D9AB + A[6][l], doubleHash[l], 24);
+    }
 
-    return 1;
-}
\ No newline at end of file
+    return found;
+}
+
+RAM_ATTR uint32_t nerd_sha256d_range_interleaved(nerdSHA256_context *midstate, uint32_t start_nonce, uint32_t count, const uint8_t share_target[SHA256_HASH_SIZE], nerdSHA256_range_result *results)
+{
+    uint8_t doubleHash[NERD_INTERLEAVE][NERD_SHA256_BLOCK_SIZE];
+    uint32_t w3[NERD_INTERLEAVE];
+
+    results->count = 0;
+
+    uint32_t scanned = 0;
+    while (scanned < count)
+    {
+        // A última volta pode passar de count, as lanes excedentes são descartadas
+        for (int l = 0; l < NERD_INTERLEAVE; l++)
+        {
+            w3[l] = __builtin_bswap32(start_nonce + scanned + l);
+        }
+        const uint32_t found = nerd_double_hash_lanes(midstate, w3, doubleHash);
+
+        for (int l = 0; l < NERD_INTERLEAVE && scanned < count; l++)
+        {
+            scanned++;
+            if (((found >> l) & 1) && (share_target == nullptr || nerd_below_target(doubleHash[l], share_target)))
+            {
+                results->nonce[results->count] = start_nonce + scanned - 1;
+                memcpy(results->hash[results->count], doubleHash[l], SHA256_HASH_SIZE);
+                if (++results->count == NERD_RANGE_MAX_RESULTS)
+                {
+                    return scanned;
+                }
+            }
+        }
+    }
+
+    return scanned;
+}
+#endif // NERD_INTERLEAVE
@@ -17,22 +17,56 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <Arduino.h>
+#include <string.h>
 
 #include "utils/platform.h"
 
 #define NERD_SHA256_BLOCK_SIZE 64
 #define NERD_BITCOIN_BLOCK_SIZE 80
 #define NERD_JOB_BLOCK_SIZE 16
+#define NERD_RANGE_MAX_RESULTS 4
+#define SHA256_HASH_SIZE 32
+
+/* Number of nonces carried together through the rounds by nerd_sha256d_range_interleaved (1 = disabled) */
+#ifndef NERD_INTERLEAVE
+#define NERD_INTERLEAVE 1
+#endif
 
 struct nerdSHA256_context
 {
     uint8_t buffer[NERD_SHA256_BLOCK_SIZE];
     uint32_t digest[8];
+    /* Nonce-independent part of the second block, filled by nerd_mids() */
+    uint32_t tail_state[8]; // state after rounds 0-2
+    uint32_t tail_t1;       // round 3 temp1 without the nonce word
+    uint32_t tail_t2;       // round 3 temp2
+    uint32_t tail_w[4];     // W16, W17 and the fixed parts of W18, W19
+};
+
+/* Candidates returned by nerd_sha256d_range */
+struct nerdSHA256_range_result
+{
+    uint32_t count;
+    uint32_t nonce[NERD_RANGE_MAX_RESULTS];
+    uint8_t hash[NERD_RANGE_MAX_RESULTS][SHA256_HASH_SIZE];
 };
 
-/* Calculate midstate */
-RAM_ATTR void nerd_mids(nerdSHA256_context *midstate, uint8_t dataIn[NERD_SHA256_BLOCK_SIZE]);
+/* Calculate midstate from the 80 bytes header, including the nonce-independent rounds of the second block.
+   Must be called again whenever merkle root, ntime or nbits change. */
+RAM_ATTR void nerd_mids(nerdSHA256_context *midstate, uint8_t dataIn[NERD_BITCOIN_BLOCK_SIZE]);
+/* Only the nonce (last word) of dataIn is read, the rest of the tail comes from nerd_mids() */
 RAM_ATTR uint8_t nerd_sha256d(nerdSHA256_context *midstate, uint8_t dataIn[NERD_JOB_BLOCK_SIZE], uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE]);
+/* Scan count nonces from start_nonce, keeping only hashes below share_target (every early-exit pass when null).
+   The header tail comes from nerd_mids(), only the nonce changes.
+   Returns the number of nonces scanned, which is less than count only when results is full. */
+RAM_ATTR uint32_t nerd_sha256d_range(nerdSHA256_context *midstate, uint32_t start_nonce, uint32_t count, const uint8_t share_target[SHA256_HASH_SIZE], nerdSHA256_range_result *results);
+#if NERD_INTERLEAVE > 1
+/* Same contract as nerd_sha256d_range, hashing NERD_INTERLEAVE nonces side by side */
+RAM_ATTR uint32_t nerd_sha256d_range_interleaved(nerdSHA256_context *midstate, uint32_t start_nonce, uint32_t count, const uint8_t share_target[SHA256_HASH_SIZE], nerdSHA256_range_result *results);
+#endif
+#if defined(UNIT_TEST)
+/* Same contract as nerd_sha256d with two plain 64 round compressions, the baseline the benchmarks compare against */
+uint8_t nerd_sha256d_generic(nerdSHA256_context *midstate, uint8_t dataIn[NERD_JOB_BLOCK_SIZE], uint8_t doubleHash[NERD_SHA256_BLOCK_SIZE]);
+#endif
 
 #endif
\ No newline at end of file
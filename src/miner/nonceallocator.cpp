@@ -0,0 +1,35 @@
+#include "miner/nonceallocator.h"
+
+void NonceAllocator::reset()
+{
+    cursor = 0;
+}
+
+bool NonceAllocator::next(uint32_t &start)
+{
+#if defined(ESP8266)
+    const uint32_t range = cursor;
+    if (range < NONCE_RANGE_COUNT)
+    {
+        cursor++;
+    }
+#else
+    const uint32_t range = cursor.fetch_add(1, std::memory_order_relaxed);
+#endif
+    if (range >= NONCE_RANGE_COUNT)
+    {
+        return false;
+    }
+
+    start = range << NONCE_RANGE_BITS;
+    return true;
+}
+
+bool NonceAllocator::isExhausted() const
+{
+#if defined(ESP8266)
+    return cursor >= NONCE_RANGE_COUNT;
+#else
+    return cursor.load(std::memory_order_relaxed) >= NONCE_RANGE_COUNT;
+#endif
+}
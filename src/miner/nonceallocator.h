@@ -0,0 +1,46 @@
+#ifndef NONCEALLOCATOR_H
+#define NONCEALLOCATOR_H
+
+#include <stdint.h>
+#if !defined(ESP8266)
+#include <atomic>
+#endif
+
+#define NONCE_RANGE_BITS 16
+#define NONCE_RANGE_SIZE (1UL << NONCE_RANGE_BITS)        // Nonces per range, ~1-4 s of work per core
+#define NONCE_RANGE_COUNT (1UL << (32 - NONCE_RANGE_BITS)) // Ranges in the 2^32 nonce space
+
+/**
+ * Hands out disjoint, contiguous ranges of the 32-bit nonce space.
+ * The cursor counts ranges instead of nonces so a fetch-add never wraps
+ * back into ranges that were already given out, and the space is exhausted
+ * once the cursor reaches NONCE_RANGE_COUNT.
+ */
+class NonceAllocator
+{
+public:
+    /**
+     * Starts over from the first range.
+     */
+    void reset();
+
+    /**
+     * Claims the next free range.
+     *
+     * @param start Receives the first nonce of the range.
+     * @return false if the nonce space is exhausted.
+     */
+    bool next(uint32_t &start);
+
+    bool isExhausted() const;
+
+private:
+#if defined(ESP8266)
+    // Single core, the miner runs in loop() only
+    uint32_t cursor = 0;
+#else
+    std::atomic<uint32_t> cursor{0};
+#endif
+};
+
+#endif // NONCEALLOCATOR_H
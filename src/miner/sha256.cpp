@@ -46,47 +46,27 @@ MEM_ATTR static const uint8_t sha256_padding[SHA256M_BUFFER_SIZE] = {
         (h) = temp1 + temp2;                           \
     }
 
-uint32_t total[2];
-uint32_t state[8];
-uint8_t data[SHA256M_BUFFER_SIZE];
-
-void sha256_init()
+void sha256_init(sha256m_context *ctx)
 {
-    total[0] = 0;
-    total[1] = 0;
-
-    state[0] = 0x6A09E667;
-    state[1] = 0xBB67AE85;
-    state[2] = 0x3C6EF372;
-    state[3] = 0xA54FF53A;
-    state[4] = 0x510E527F;
-    state[5] = 0x9B05688C;
-    state[6] = 0x1F83D9AB;
-    state[7] = 0x5BE0CD19;
+    ctx->total[0] = 0;
+    ctx->total[1] = 0;
+
+    ctx->state[0] = 0x6A09E667;
+    ctx->state[1] = 0xBB67AE85;
+    ctx->state[2] = 0x3C6EF372;
+    ctx->state[3] = 0xA54FF53A;
+    ctx->state[4] = 0x510E527F;
+    ctx->state[5] = 0x9B05688C;
+    ctx->state[6] = 0x1F83D9AB;
+    ctx->state[7] = 0x5BE0CD19;
 }
 
-inline void transform(const uint8_t msg[SHA256M_BUFFER_SIZE])
+// Rounds over a schedule whose first 16 words are already loaded in W
+static inline void transform_words(uint32_t state[8], uint32_t W[SHA256M_BUFFER_SIZE])
 {
-    uint32_t temp1, temp2, W[SHA256M_BUFFER_SIZE];
+    uint32_t temp1, temp2;
     uint32_t A, B, C, D, E, F, G, H;
 
-    GET_UINT32(W[0], msg, 0);
-    GET_UINT32(W[1], msg, 4);
-    GET_UINT32(W[2], msg, 8);
-    GET_UINT32(W[3], msg, 12);
-    GET_UINT32(W[4], msg, 16);
-    GET_UINT32(W[5], msg, 20);
-    GET_UINT32(W[6], msg, 24);
-    GET_UINT32(W[7], msg, 28);
-    GET_UINT32(W[8], msg, 32);
-    GET_UINT32(W[9], msg, 36);
-    GET_UINT32(W[10], msg, 40);
-    GET_UINT32(W[11], msg, 44);
-    GET_UINT32(W[12], msg, 48);
-    GET_UINT32(W[13], msg, 52);
-    GET_UINT32(W[14], msg, 56);
-    GET_UINT32(W[15], msg, 60);
-
     A = state[0];
     B = state[1];
     C = state[2];
@@ -171,27 +151,100 @@ inline void transform(const uint8_t msg[SHA256M_BUFFER_SIZE])
     state[7] += H;
 }
 
-inline void update(const uint8_t *msg, size_t length)
+static inline void transform(sha256m_context *ctx, const uint8_t msg[SHA256M_BUFFER_SIZE])
+{
+    uint32_t W[SHA256M_BUFFER_SIZE];
+
+    GET_UINT32(W[0], msg, 0);
+    GET_UINT32(W[1], msg, 4);
+    GET_UINT32(W[2], msg, 8);
+    GET_UINT32(W[3], msg, 12);
+    GET_UINT32(W[4], msg, 16);
+    GET_UINT32(W[5], msg, 20);
+    GET_UINT32(W[6], msg, 24);
+    GET_UINT32(W[7], msg, 28);
+    GET_UINT32(W[8], msg, 32);
+    GET_UINT32(W[9], msg, 36);
+    GET_UINT32(W[10], msg, 40);
+    GET_UINT32(W[11], msg, 44);
+    GET_UINT32(W[12], msg, 48);
+    GET_UINT32(W[13], msg, 52);
+    GET_UINT32(W[14], msg, 56);
+    GET_UINT32(W[15], msg, 60);
+
+    transform_words(ctx->state, W);
+}
+
+// K + W of the padding block of a 64 byte message (0x80, zeros, length 512 bits), the schedule never changes
+MEM_ATTR static const uint32_t sha256_pad64_kw[SHA256M_BUFFER_SIZE] = {
+    0xC28A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+    0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF374,
+    0x649B69C1, 0xF0FE4786, 0x0FE1EDC6, 0x240CF254,
+    0x4FE9346F, 0x6CC984BE, 0x61B9411E, 0x16F988FA,
+    0xF2C65152, 0xA88E5A6D, 0xB019FC65, 0xB9D99EC7,
+    0x9A1231C3, 0xE70EEAA0, 0xFDB1232B, 0xC7353EB0,
+    0x3069BAD5, 0xCB976D5F, 0x5A0F118F, 0xDC1EEEFD,
+    0x0A35B689, 0xDE0B7A04, 0x58F4CA9D, 0xE15D5B16,
+    0x007F3E86, 0x37088980, 0xA507EA32, 0x6FAB9537,
+    0x17406110, 0x0D8CD6F1, 0xCDAA3B6D, 0xC0BBBE37,
+    0x83613BDA, 0xDB48A363, 0x0B02E931, 0x6FD15CA7,
+    0x521AFACA, 0x31338431, 0x6ED41A95, 0x6D437890,
+    0xC39C91F2, 0x9ECCABBD, 0xB5C9A0E6, 0x532FB63C,
+    0xD2C741C6, 0x07237EA3, 0xA4954B68, 0x4C191D76
+};
+
+// Rounds with K + W already summed, for blocks known ahead of time
+static inline void transform_kw(uint32_t state[8], const uint32_t KW[SHA256M_BUFFER_SIZE])
+{
+    uint32_t temp1, temp2;
+    uint32_t A = state[0], B = state[1], C = state[2], D = state[3];
+    uint32_t E = state[4], F = state[5], G = state[6], H = state[7];
+
+    for (int i = 0; i < SHA256M_BUFFER_SIZE; i += 8)
+    {
+        P(A, B, C, D, E, F, G, H, 0, KW[i]);
+        P(H, A, B, C, D, E, F, G, 0, KW[i + 1]);
+        P(G, H, A, B, C, D, E, F, 0, KW[i + 2]);
+        P(F, G, H, A, B, C, D, E, 0, KW[i + 3]);
+        P(E, F, G, H, A, B, C, D, 0, KW[i + 4]);
+        P(D, E, F, G, H, A, B, C, 0, KW[i + 5]);
+        P(C, D, E, F, G, H, A, B, 0, KW[i + 6]);
+        P(B, C, D, E, F, G, H, A, 0, KW[i + 7]);
+    }
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+    state[5] += F;
+    state[6] += G;
+    state[7] += H;
+}
+
+void sha256_update(sha256m_context *ctx, const uint8_t *msg, size_t length)
 {
     if (length == 0)
     {
         return;
     }
 
-    uint32_t left = total[0] & (SHA256M_BUFFER_SIZE - 1); // left < buf size
+    uint32_t left = ctx->total[0] & (SHA256M_BUFFER_SIZE - 1); // left < buf size
 
-    total[0] += (uint32_t)length;
-    total[0] &= 0xFFFFFFFF;
-    if (total[0] < length)
+    ctx->total[0] += (uint32_t)length;
+    ctx->total[0] &= 0xFFFFFFFF;
+    if (ctx->total[0] < length)
     {
-        total[1]++;
+        ctx->total[1]++;
     }
     size_t fill = SHA256M_BUFFER_SIZE - left;
 
     if (left && (length >= fill))
     {
-        memcpy(data + left, msg, fill);
-        transform(data);
+        memcpy(ctx->data + left, msg, fill);
+        transform(ctx, ctx->data);
         length -= fill;
         msg += fill;
         left = 0;
@@ -199,62 +252,144 @@ inline void update(const uint8_t *msg, size_t length)
 
     while (length >= SHA256M_BUFFER_SIZE)
     {
-        transform(msg);
+        transform(ctx, msg);
         length -= SHA256M_BUFFER_SIZE;
         msg += SHA256M_BUFFER_SIZE;
     }
 
     if (length)
     {
-        memcpy(data + left, msg, length);
+        memcpy(ctx->data + left, msg, length);
     }
 }
 
-void final(uint8_t digest[SHA256M_BUFFER_SIZE])
+void sha256_final(sha256m_context *ctx, uint8_t digest[SHA256M_BLOCK_SIZE])
 {
     uint32_t last, padn;
     uint32_t high, low;
     uint8_t msglen[8];
 
-    high = (total[0] >> 29) | (total[1] << 3);
-    low = (total[0] << 3);
+    high = (ctx->total[0] >> 29) | (ctx->total[1] << 3);
+    low = (ctx->total[0] << 3);
 
     PUT_UINT32(high, msglen, 0);
     PUT_UINT32(low, msglen, 4);
 
-    last = total[0] & 0x3F;
+    last = ctx->total[0] & 0x3F;
     padn = (last < 56) ? (56 - last) : (120 - last);
 
-    update(sha256_padding, padn);
-    update(msglen, 8);
-
-    PUT_UINT32(state[0], digest, 0);
-    PUT_UINT32(state[1], digest, 4);
-    PUT_UINT32(state[2], digest, 8);
-    PUT_UINT32(state[3], digest, 12);
-    PUT_UINT32(state[4], digest, 16);
-    PUT_UINT32(state[5], digest, 20);
-    PUT_UINT32(state[6], digest, 24);
-    PUT_UINT32(state[7], digest, 28);
+    sha256_update(ctx, sha256_padding, padn);
+    sha256_update(ctx, msglen, 8);
+
+    PUT_UINT32(ctx->state[0], digest, 0);
+    PUT_UINT32(ctx->state[1], digest, 4);
+    PUT_UINT32(ctx->state[2], digest, 8);
+    PUT_UINT32(ctx->state[3], digest, 12);
+    PUT_UINT32(ctx->state[4], digest, 16);
+    PUT_UINT32(ctx->state[5], digest, 20);
+    PUT_UINT32(ctx->state[6], digest, 24);
+    PUT_UINT32(ctx->state[7], digest, 28);
 }
 
-void sha256(const uint8_t *msg, size_t len, uint8_t output[SHA256M_BUFFER_SIZE])
+void sha256_clone(sha256m_context *dst, const sha256m_context *src)
 {
-    sha256_init();
-    update(msg, len);
-    final(output);
+    memcpy(dst, src, sizeof(sha256m_context));
+}
+
+void sha256(const uint8_t *msg, size_t len, uint8_t output[SHA256M_BLOCK_SIZE])
+{
+    sha256m_context ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, msg, len);
+    sha256_final(&ctx, output);
 }
 
 /**
  * Performs a double SHA256 hash on the given message.
  *
- * @param ctx The SHA256 context.
  * @param msg The input message to be hashed.
  * @param len The length of the input message.
  * @param output The buffer to store the resulting hash.
  */
 void sha256_double(const uint8_t *msg, size_t len, uint8_t output[SHA256M_BUFFER_SIZE])
 {
-    sha256((uint8_t *)msg, len, output);
+    sha256(msg, len, output);
     sha256(output, SHA256M_BLOCK_SIZE, output);
 }
+
+/**
+ * Finishes a double SHA256 from a context that already holds the first part of the message.
+ * The context is left untouched so it can be reused for another suffix.
+ *
+ * @param prefix Context with the constant prefix already hashed.
+ * @param msg The rest of the message.
+ * @param len The length of the rest of the message.
+ * @param output The buffer to store the resulting hash.
+ */
+void sha256_double_from(const sha256m_context *prefix, const uint8_t *msg, size_t len, uint8_t output[SHA256M_BLOCK_SIZE])
+{
+    sha256m_context ctx;
+    sha256_clone(&ctx, prefix);
+    sha256_update(&ctx, msg, len);
+    sha256_final(&ctx, output);
+
+    sha256(output, SHA256M_BLOCK_SIZE, output);
+}
+
+/**
+ * Double SHA256 of exactly 64 bytes, as used by merkle tree nodes.
+ * The padding block of the first hash is constant and the second hash always fits
+ * in a single block, so there's no buffering, length bookkeeping or padding copies.
+ *
+ * @param msg The 64 byte message (left + right node).
+ * @param output The buffer to store the resulting hash.
+ */
+void sha256d_64(const uint8_t msg[SHA256M_BUFFER_SIZE], uint8_t output[SHA256M_BLOCK_SIZE])
+{
+    uint32_t W[SHA256M_BUFFER_SIZE];
+    uint32_t state[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+    GET_UINT32(W[0], msg, 0);
+    GET_UINT32(W[1], msg, 4);
+    GET_UINT32(W[2], msg, 8);
+    GET_UINT32(W[3], msg, 12);
+    GET_UINT32(W[4], msg, 16);
+    GET_UINT32(W[5], msg, 20);
+    GET_UINT32(W[6], msg, 24);
+    GET_UINT32(W[7], msg, 28);
+    GET_UINT32(W[8], msg, 32);
+    GET_UINT32(W[9], msg, 36);
+    GET_UINT32(W[10], msg, 40);
+    GET_UINT32(W[11], msg, 44);
+    GET_UINT32(W[12], msg, 48);
+    GET_UINT32(W[13], msg, 52);
+    GET_UINT32(W[14], msg, 56);
+    GET_UINT32(W[15], msg, 60);
+
+    transform_words(state, W);
+    transform_kw(state, sha256_pad64_kw);
+
+    // Second hash: 32 byte digest, 0x80, zeros, length 256 bits
+    for (int i = 0; i < 8; i++)
+    {
+        W[i] = state[i];
+    }
+    W[8] = 0x80000000;
+    for (int i = 9; i < 15; i++)
+    {
+        W[i] = 0;
+    }
+    W[15] = 256;
+
+    uint32_t digest[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+    transform_words(digest, W);
+
+    PUT_UINT32(digest[0], output, 0);
+    PUT_UINT32(digest[1], output, 4);
+    PUT_UINT32(digest[2], output, 8);
+    PUT_UINT32(digest[3], output, 12);
+    PUT_UINT32(digest[4], output, 16);
+    PUT_UINT32(digest[5], output, 20);
+    PUT_UINT32(digest[6], output, 24);
+    PUT_UINT32(digest[7], output, 28);
+}
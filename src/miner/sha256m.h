@@ -7,5 +7,24 @@
 #define SHA256M_BLOCK_SIZE 32
 #define SHA256M_BUFFER_SIZE 64
 
+// Streaming SHA256 state, independent per caller so it can be used from any task
+struct sha256m_context
+{
+    uint32_t total[2];
+    uint32_t state[8];
+    uint8_t data[SHA256M_BUFFER_SIZE];
+};
+
+void sha256_init(sha256m_context *ctx);
+void sha256_update(sha256m_context *ctx, const uint8_t *msg, size_t len);
+void sha256_final(sha256m_context *ctx, uint8_t digest[SHA256M_BLOCK_SIZE]);
+// Copies the state, to resume hashing from a saved prefix
+void sha256_clone(sha256m_context *dst, const sha256m_context *src);
+
+void sha256(const uint8_t *msg, size_t len, uint8_t output[SHA256M_BLOCK_SIZE]);
 void sha256_double(const uint8_t *msg, size_t len, uint8_t output[SHA256M_BUFFER_SIZE]);
+// Double SHA256 of (prefix already in the context) + msg, the context is not modified
+void sha256_double_from(const sha256m_context *prefix, const uint8_t *msg, size_t len, uint8_t output[SHA256M_BLOCK_SIZE]);
+// Double SHA256 of a 64 byte message (merkle node) with the padding hard-coded
+void sha256d_64(const uint8_t msg[SHA256M_BUFFER_SIZE], uint8_t output[SHA256M_BLOCK_SIZE]);
 #endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include <Arduino.h>
+#include "miner/tuner.h"
+#include "miner/engine.h"
+#include "storage/storage.h"
+#include "utils/log.h"
+
+char TAG_TUNER[] = "Tuner";
+
+static const uint32_t batch_sizes[] = {256, 512, 1024, 2048, 4096};
+static const uint32_t yield_intervals[] = {10, 33, 100};
+
+void tuner_yield()
+{
+#if defined(ESP32)
+    vTaskDelay(1);
+#else
+    ESP.wdtFeed();
+    yield();
+#endif
+}
+
+static tuner_point tuner_measure(uint32_t batch_size, uint32_t yield_ms)
+{
+    // O conteúdo do header não muda o custo do hash, target zero faz o range ser varrido inteiro
+    uint8_t header[NERD_BITCOIN_BLOCK_SIZE] = {};
+    const uint8_t target[SHA256_HASH_SIZE] = {};
+
+    const hash_engine *engine = engine_get();
+    nerdSHA256_context ctx;
+    nerdSHA256_range_result result;
+    engine->init(&ctx, header);
+
+    tuner_point point = {batch_size, yield_ms, 0, 0};
+    uint32_t nonce = 0;
+    uint32_t hashes = 0;
+    const uint32_t start = millis();
+    uint32_t last_yield = start;
+
+    while (millis() - start < TUNER_WINDOW_MS)
+    {
+        hashes += engine->scan(&ctx, nonce, batch_size, target, &result);
+        nonce += batch_size;
+
+        const uint32_t gap = millis() - last_yield;
+        if (gap >= yield_ms)
+        {
+            if (gap > point.max_gap_ms)
+            {
+                point.max_gap_ms = gap;
+            }
+            tuner_yield();
+            last_yield = millis();
+        }
+    }
+
+    point.hashrate = hashes / (double)(millis() - start); // hashes/ms = kH/s
+    return point;
+}
+
+tuner_point tuner_sweep()
+{
+    tuner_point best = {0, 0, 0, 0};
+
+    for (uint32_t yield_ms : yield_intervals)
+    {
+        for (uint32_t batch_size : batch_sizes)
+        {
+            const tuner_point point = tuner_measure(batch_size, yield_ms);
+            l_debug(TAG_TUNER, "batch %d, yield %d ms: %.2f kH/s, max gap %d ms", point.batch_size, point.yield_ms, point.hashrate, point.max_gap_ms);
+
+            if (point.max_gap_ms > TUNER_MAX_GAP_MS)
+            {
+                continue;
+            }
+            if (point.hashrate > best.hashrate * 1.02)
+            {
+                best = point;
+            }
+        }
+    }
+
+    if (best.batch_size == 0)
+    {
+        // Nenhum ponto seguro, fica com o menor lote e a menor pausa
+        best.batch_size = batch_sizes[0];
+        best.yield_ms = yield_intervals[0];
+    }
+
+    return best;
+}
+
+void tuner_setup(Configuration &conf)
+{
+    if (conf.batch_size > 0 && conf.yield_ms > 0)
+    {
+        l_info(TAG_TUNER, "Tuned: batch %d, yield %d ms", conf.batch_size, conf.yield_ms);
+        return;
+    }
+
+    l_info(TAG_TUNER, "Tuning batch size and yield interval...");
+    const tuner_point best = tuner_sweep();
+    l_info(TAG_TUNER, "Tuned: batch %d, yield %d ms (%.2f kH/s)", best.batch_size, best.yield_ms, best.hashrate);
+
+    conf.batch_size = best.batch_size;
+    conf.yield_ms = best.yield_ms;
+    storage_save(conf);
+}
@@ -0,0 +1,36 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <stdint.h>
+#include "model/configuration.h"
+
+#define TUNER_WINDOW_MS 250  // Tempo medido para cada ponto da varredura
+#define TUNER_MAX_GAP_MS 250 // Maior intervalo aceito sem ceder a CPU, bem abaixo dos watchdogs (3.2s ESP8266, 5s ESP32)
+
+struct tuner_point
+{
+    uint32_t batch_size;
+    uint32_t yield_ms;
+    double hashrate; // kH/s sustentado, já contando as pausas
+    uint32_t max_gap_ms;
+};
+
+/**
+ * Sweeps batch size and yield interval with the selected engine and returns the fastest
+ * point whose longest stretch without yielding stays under TUNER_MAX_GAP_MS.
+ * Points within 2% of each other prefer the shorter yield interval and the smaller batch.
+ */
+tuner_point tuner_sweep();
+
+/**
+ * Runs the sweep once and stores the result through storage_save(),
+ * boots with a tuned configuration skip it.
+ */
+void tuner_setup(Configuration &conf);
+
+/**
+ * Gives the CPU back to the system: a tick on ESP32, watchdog feed and yield on ESP8266.
+ */
+void tuner_yield();
+
+#endif // TUNER_H
@@ -20,6 +20,8 @@ struct Configuration
     std::string lcd_on_start = "";
     std::string miner_type = "";
     std::string auto_update = "";
+    int batch_size = 0; // Nonces por chamada do kernel, 0 = ainda não calibrado
+    int yield_ms = 0;   // Intervalo entre pausas do minerador, 0 = ainda não calibrado
 
     void print()
     {
@@ -34,6 +36,8 @@ struct Configuration
         l_info(TAG_CONFIGURATION, "lcd_on_start: %s", lcd_on_start.c_str());
         l_info(TAG_CONFIGURATION, "miner_type: %s", miner_type.c_str());
         l_info(TAG_CONFIGURATION, "auto_update: %s", auto_update.c_str());
+        l_info(TAG_CONFIGURATION, "batch_size: %d", batch_size);
+        l_info(TAG_CONFIGURATION, "yield_ms: %d", yield_ms);
     }
 };
 
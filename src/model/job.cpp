@@ -6,66 +6,226 @@
 #endif
 #include <climits>
 
-uint8_t Job::pickaxe(uint32_t core, uint8_t *hash, uint32_t &winning_nonce)
+uint32_t Job::pickaxe(uint32_t core, uint32_t count, const uint8_t *share_target, nerdSHA256_range_result &result)
 {
-    nextNonce(core);
-    winning_nonce = block.nonce;
-    return nerd_sha256d(&sha, reinterpret_cast<unsigned char *>(&block) + 64, hash);
+    Lane &lane = lanes[core];
+    if (lane.generation != generation)
+    {
+        syncLane(lane, core);
+    }
+
+    if (lane.remaining == 0 && !claimNonces(lane))
+    {
+        // Nonce space of this extranonce2 is over, move to the next one
+        if (!rollExtranonce2(lane.generation))
+        {
+            return 0;
+        }
+        syncLane(lane, core);
+        if (!claimNonces(lane))
+        {
+            return 0;
+        }
+    }
+
+    if (count > lane.remaining)
+    {
+        count = lane.remaining;
+    }
+
+    const uint32_t scanned = engine_get()->scan(&lane.sha, lane.nonce, count, share_target, &result);
+    lane.nonce += scanned;
+    lane.remaining -= scanned;
+    return scanned;
+}
+
+std::string Job::getExtranonce2(uint32_t core) const
+{
+    return formatExtranonce2(lanes[core].extranonce2, extranonce2_size);
+}
+
+uint32_t Job::getVersionBits(uint32_t core) const
+{
+    return lanes[core].version & version_mask;
+}
+
+bool Job::claimNonces(Lane &lane)
+{
+    if (version_mask == 0)
+    {
+        // Cores share the nonce space of the header, one range at a time
+        if (!templates[lane.generation & 1].nonces.next(lane.nonce))
+        {
+            return false;
+        }
+        lane.remaining = NONCE_RANGE_SIZE;
+        return true;
+    }
+
+    // Each core owns every CORE-th version, with the whole nonce space of each
+    if (lane.version_index >= version_count)
+    {
+        return false;
+    }
+    rollVersion(lane);
+    lane.version_index += CORE;
+    lane.nonce = 0;
+    lane.remaining = 1ULL << 32;
+    return true;
+}
+
+void Job::rollVersion(Lane &lane)
+{
+    // Spread the bits of the version index over the mask
+    uint32_t bits = 0;
+    uint32_t index = lane.version_index;
+    for (uint32_t bit = 1; bit != 0 && index != 0; bit <<= 1)
+    {
+        if (version_mask & bit)
+        {
+            bits |= (index & 1) ? bit : 0;
+            index >>= 1;
+        }
+    }
+
+    // Index 0 keeps the pool's version, so the first version of core 0 needs no rolling at all
+    Block header = templates[lane.generation & 1].header;
+    header.version ^= bits;
+    engine_get()->init(&lane.sha, reinterpret_cast<unsigned char *>(&header));
+    lane.version = header.version;
 }
 
-void Job::setStartNonce(uint32_t start_nonce)
+void Job::syncLane(Lane &lane, uint32_t core)
 {
-    block.nonce = start_nonce;
+    const uint32_t current = generation;
+    const Template &slot = templates[current & 1];
+    lane.sha = slot.sha;
+    lane.extranonce2 = slot.extranonce2;
+    lane.generation = current;
+    lane.remaining = 0;
+    lane.version = slot.header.version;
+    lane.version_index = core;
 }
 
-void Job::nextNonce(uint32_t core)
+bool Job::rollExtranonce2(uint32_t expected_generation)
 {
-    block.nonce += (core % 2 == 0) ? 1 : 2;
+    if (extranonce2_exhausted)
+    {
+        return false;
+    }
+
+    // Only one core rebuilds the header, the others wait for the new generation
+#if defined(ESP8266)
+    if (rolling)
+    {
+        return false;
+    }
+    rolling = true;
+#else
+    if (rolling.exchange(true))
+    {
+        return false;
+    }
+#endif
+
+    bool rolled = true;
+    if (generation == expected_generation)
+    {
+        const uint64_t next = (templates[expected_generation & 1].extranonce2 + 1) & extranonce2_mask;
+        if (next == extranonce2_start)
+        {
+            l_error(TAG_JOB, "Extranonce2 space exhausted, waiting for a new job");
+            extranonce2_exhausted = true;
+            rolled = false;
+        }
+        else
+        {
+            Block header = block;
+            buildTemplate(templates[(expected_generation + 1) & 1], header, next);
+            generation = expected_generation + 1;
+            l_info(TAG_JOB, "Nonce space exhausted, rolled extranonce2 to %s", formatExtranonce2(next, extranonce2_size).c_str());
+        }
+    }
+
+    rolling = false;
+    return rolled;
 }
 
-Job::Job(const Notification &notification, const Subscribe &subscribe, double difficulty) : difficulty(difficulty)
+void Job::buildTemplate(Template &slot, Block &header, uint64_t extranonce2)
 {
     try
     {
-        // Initialize variables
-        const char *version = notification.version.c_str();
-        const char *prevhash = notification.prevhash.c_str();
-        const char *ntime_string = notification.ntime.c_str();
-        const char *nbits = notification.nbits.c_str();
+        // Calculate coinbase hash
+        uint8_t coinbase_hash[SHA256M_BLOCK_SIZE];
+        generateCoinbaseHash(extranonce2, coinbase_hash);
 
+        // Calculate merkle root
+        calculateMerkleRoot(coinbase_hash, header.merkle_root);
+        header.nonce = 0;
+
+        // Initialize SHA context
+        engine_get()->init(&slot.sha, reinterpret_cast<unsigned char *>(&header));
+        slot.extranonce2 = extranonce2;
+        slot.nonces.reset();
+        slot.header = header;
+    }
+    catch (...)
+    {
+        l_error(TAG_JOB, "Exception occurred.");
+    }
+}
+
+Job::Job(const Notification &notification, const Subscribe &subscribe, double difficulty, uint32_t version_mask) : version_mask(version_mask), difficulty(difficulty)
+{
+    try
+    {
         job_id = notification.job_id;
+        char ntime_string[9];
+        snprintf(ntime_string, sizeof(ntime_string), "%08x", notification.ntime);
         ntime = ntime_string;
 
+        // Keep what is needed to rebuild the coinbase with another extranonce2
+        memcpy(merkle_branch, notification.merkle_branch, sizeof(merkle_branch[0]) * notification.merkle_branch_count);
+        merkle_branch_count = notification.merkle_branch_count;
+        extranonce2_size = subscribe.extranonce2_size;
+
+        // Hash the constant coinb1 + extranonce1 prefix once
+        std::vector<uint8_t> extranonce1(subscribe.extranonce1.length() / 2);
+        hexStringToByteArray(subscribe.extranonce1.c_str(), extranonce1.data());
+        sha256_init(&coinbase_prefix);
+        sha256_update(&coinbase_prefix, notification.coinb1, notification.coinb1_size);
+        sha256_update(&coinbase_prefix, extranonce1.data(), extranonce1.size());
+
+        // Room for the extranonce2, then coinb2
+        coinbase_tail.resize(extranonce2_size + notification.coinb2_size);
+        memcpy(coinbase_tail.data() + extranonce2_size, notification.coinb2, notification.coinb2_size);
+        extranonce2_mask = extranonce2_size >= 8 ? UINT64_MAX : (1ULL << (8 * extranonce2_size)) - 1;
+
         // Generate extranonce2
 #ifndef UNIT_TEST
-        extranonce2 = generate_extra_nonce2(subscribe.extranonce2_size);
+        extranonce2_start = generate_extra_nonce2() & extranonce2_mask;
 #else
-        extranonce2 = "00000002";
+        extranonce2_start = 2;
 #endif
 
-        // Calculate coinbase hash
-        const std::string coinbase = notification.coinb1 + subscribe.extranonce1 + extranonce2 + notification.coinb2;
-        std::string coinbase_hash;
-        generateCoinbaseHash(coinbase, coinbase_hash);
-
-        // Calculate merkle root
-        std::string merkle_root;
-        calculateMerkleRoot(coinbase_hash, notification.merkle_branch, merkle_root);
-
         // Populate block data
-        block.version = strtoul(version, nullptr, 16);
-        hexStringToByteArray(prevhash, block.previous_block);
+        block.version = notification.version;
+        memcpy(block.previous_block, notification.prevhash, sizeof(block.previous_block));
         reverseBytesAndFlip(block.previous_block, 32);
-        hexStringToByteArray(merkle_root.c_str(), block.merkle_root);
-        block.ntime = strtoul(ntime.c_str(), nullptr, 16);
-        block.nbits = strtoul(nbits, nullptr, 16);
-        block.nonce = 0;
+        block.ntime = notification.ntime;
+        block.nbits = notification.nbits;
 
         // Calculate target
-        target.calculate(nbits);
+        target.calculate(notification.nbits);
 
-        // Initialize SHA context
-        nerd_mids(&sha, reinterpret_cast<unsigned char *>(&block));
+        setVersionCount();
+
+        // Merkle root and midstate of the first extranonce2
+        buildTemplate(templates[0], block, extranonce2_start);
+        for (uint32_t core = 0; core < CORE; core++)
+        {
+            syncLane(lanes[core], core);
+        }
     }
     catch (...)
     {
@@ -73,45 +233,93 @@ Job::Job(const Notification &notification, const Subscribe &subscribe, double di
     }
 }
 
-std::string Job::generate_extra_nonce2(int extranonce2_size)
+Job::Job(const Job &job, uint32_t version_mask) : block(job.block), target(job.target), job_id(job.job_id), ntime(job.ntime), version_mask(version_mask),
+                                                  coinbase_prefix(job.coinbase_prefix), coinbase_tail(job.coinbase_tail), merkle_branch_count(job.merkle_branch_count),
+                                                  extranonce2_size(job.extranonce2_size), extranonce2_mask(job.extranonce2_mask), extranonce2_start(job.extranonce2_start),
+                                                  difficulty(job.difficulty)
 {
     try
     {
-        // Generate a random number between 0 and INT_MAX
+        memcpy(merkle_branch, job.merkle_branch, sizeof(merkle_branch[0]) * merkle_branch_count);
+        setVersionCount();
+
+        // The headers of job's current extranonce2 may already have been hashed, move past it.
+        // If it was the last one it is hashed again, only with the new versions
+        const uint64_t current = job.templates[job.generation & 1].extranonce2;
+        uint64_t next = (current + 1) & extranonce2_mask;
+        if (next == extranonce2_start)
+        {
+            next = current;
+        }
+
+        buildTemplate(templates[0], block, next);
+        for (uint32_t core = 0; core < CORE; core++)
+        {
+            syncLane(lanes[core], core);
+        }
+    }
+    catch (...)
+    {
+        l_error(TAG_JOB, "Exception occurred.");
+    }
+}
+
+void Job::setVersionCount()
+{
+    // Number of versions the rolled bits can take
+    const int version_bits = __builtin_popcount(version_mask);
+    version_count = version_bits >= 32 ? UINT32_MAX : 1UL << version_bits;
+}
+
+std::string Job::formatExtranonce2(uint64_t extranonce2, int size)
+{
+    // Big-endian hex with size bytes, as it goes into the coinbase
+    std::string hex;
+    char byte_hex[3];
+    for (int i = size - 1; i >= 0; i--)
+    {
+        const uint8_t value = i < 8 ? (uint8_t)(extranonce2 >> (8 * i)) : 0;
+        snprintf(byte_hex, sizeof(byte_hex), "%02X", value);
+        hex += byte_hex;
+    }
+    return hex;
+}
+
+uint64_t Job::generate_extra_nonce2()
+{
+    try
+    {
+        // Generate a random starting point for the extranonce2
 #if defined(ESP8266)
         randomSeed(analogRead(A0));
-        uint32_t randomValue = random();
+        const uint64_t randomValue = ((uint64_t)random() << 32) | (uint32_t)random();
 #else
-        uint32_t randomValue = esp_random();
+        const uint64_t randomValue = ((uint64_t)esp_random() << 32) | esp_random();
 #endif
-        l_info(TAG_JOB, "Random value: %u", randomValue);
-
-        // Convert the random number to a hex string
-        char hexString[9]; // Enough to hold a 32-bit integer in hex (including null terminator)
-        snprintf(hexString, sizeof(hexString), "%08X", randomValue);
+        l_info(TAG_JOB, "Random value: %llu", randomValue);
 
-        l_info(TAG_JOB, "Hex value: %s", hexString);
-
-        return std::string(hexString);
+        return randomValue;
     }
     catch (...)
     {
         l_error(TAG_JOB, "Exception occurred.");
-        return ""; // Return empty string in case of error
+        return 0;
     }
 }
 
-void Job::generateCoinbaseHash(const std::string &coinbase, std::string &coinbase_hash)
+void Job::generateCoinbaseHash(uint64_t extranonce2, uint8_t coinbase_hash[SHA256M_BLOCK_SIZE])
 {
     try
     {
-        const size_t len = coinbase.length();
-        uint8_t coinbaseBytes[len / 2];
-        hexStringToByteArray(coinbase.c_str(), coinbaseBytes);
-        uint8_t hash[SHA256M_BLOCK_SIZE];
-        sha256_double(coinbaseBytes, len / 2, hash);
-        coinbase_hash = byteArrayToHexString(hash, SHA256M_BLOCK_SIZE);
-        l_debug(TAG_JOB, "Coinbase hash: %s", coinbase_hash.c_str());
+        // Big-endian extranonce2, same byte order as formatExtranonce2()
+        for (int i = 0; i < extranonce2_size; i++)
+        {
+            const int shift = extranonce2_size - 1 - i;
+            coinbase_tail[i] = shift < 8 ? (uint8_t)(extranonce2 >> (8 * shift)) : 0;
+        }
+
+        sha256_double_from(&coinbase_prefix, coinbase_tail.data(), coinbase_tail.size(), coinbase_hash);
+        l_debug(TAG_JOB, "Coinbase hash: %s", byteArrayToHexString(coinbase_hash, SHA256M_BLOCK_SIZE).c_str());
     }
     catch (...)
     {
@@ -119,30 +327,21 @@ void Job::generateCoinbaseHash(const std::string &coinbase, std::string &coinbas
     }
 }
 
-void Job::calculateMerkleRoot(const std::string &coinbase_hash, const std::vector<std::string> &merkle_branch, std::string &merkle_root)
+void Job::calculateMerkleRoot(const uint8_t coinbase_hash[SHA256M_BLOCK_SIZE], uint8_t merkle_root[SHA256M_BLOCK_SIZE])
 {
     try
     {
-        uint8_t hash[SHA256M_BLOCK_SIZE] = {};
-        hexStringToByteArray(coinbase_hash.c_str(), hash);
+        uint8_t merkle_concatenated[SHA256M_BLOCK_SIZE * 2];
+        memcpy(merkle_concatenated, coinbase_hash, SHA256M_BLOCK_SIZE);
 
-        for (const auto &branch : merkle_branch)
+        for (size_t i = 0; i < merkle_branch_count; i++)
         {
-            uint8_t merkle_branch_bin[32];
-            hexStringToByteArray(branch.c_str(), merkle_branch_bin);
-
-            uint8_t merkle_concatenated[SHA256M_BLOCK_SIZE * 2];
-            for (size_t j = 0; j < 32; j++)
-            {
-                merkle_concatenated[j] = hash[j];
-                merkle_concatenated[32 + j] = merkle_branch_bin[j];
-            }
-
-            sha256_double(merkle_concatenated, sizeof(merkle_concatenated), hash);
+            memcpy(merkle_concatenated + SHA256M_BLOCK_SIZE, merkle_branch[i], SHA256M_BLOCK_SIZE);
+            sha256d_64(merkle_concatenated, merkle_concatenated);
         }
 
-        merkle_root = byteArrayToHexString(hash, SHA256M_BLOCK_SIZE);
-        l_debug(TAG_JOB, "Merkle root: %s", merkle_root.c_str());
+        memcpy(merkle_root, merkle_concatenated, SHA256M_BLOCK_SIZE);
+        l_debug(TAG_JOB, "Merkle root: %s", byteArrayToHexString(merkle_root, SHA256M_BLOCK_SIZE).c_str());
     }
     catch (...)
     {
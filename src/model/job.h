@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include <vector>
+#if !defined(ESP8266)
+#include <atomic>
+#endif
 #include "leafminer.h"
 #include "subscribe.h"
 #include "notification.h"
@@ -11,6 +14,9 @@
 #include "model/target.h"
 #include "miner/sha256m.h"
 #include "miner/nerdSHA256plus.h"
+#include "miner/engine.h"
+#include "miner/nonceallocator.h"
+#include "utils/platform.h"
 #include "utils/log.h"
 
 class Job
@@ -19,22 +25,111 @@ public:
     Block block;
     Target target;
     std::string job_id;
-    std::string extranonce2;
     std::string ntime;
 
-    Job(const Notification &notification, const Subscribe &subscribe, double difficulty);
+    Job(const Notification &notification, const Subscribe &subscribe, double difficulty, uint32_t version_mask = 0);
+
+    /**
+     * Same work as job with another version mask, for a mask changed mid-session.
+     * Starts at the extranonce2 after the one job is hashing, so no header is hashed twice.
+     */
+    Job(const Job &job, uint32_t version_mask);
+
+    /**
+     * Scans up to count nonces of the core's current range, claiming a new range when it runs out.
+     * When the whole nonce space is used the extranonce2 is rolled and the header rebuilt locally.
+     * With version rolling every core hashes the full nonce space of its own versions instead,
+     * the extranonce2 is only rolled once all of them are used.
+     *
+     * @return the number of nonces scanned, 0 if there is nothing left to mine right now.
+     */
+    uint32_t pickaxe(uint32_t core, uint32_t count, const uint8_t *share_target, nerdSHA256_range_result &result);
+
+    /**
+     * @return the extranonce2 of the header the core is hashing, to be sent with its shares.
+     */
+    std::string getExtranonce2(uint32_t core) const;
+    uint64_t getExtranonce2Value(uint32_t core) const { return lanes[core].extranonce2; }
+    int getExtranonce2Size() const { return extranonce2_size; }
+
+    /**
+     * Big-endian hex of the extranonce2 with size bytes, as it goes into the coinbase.
+     */
+    static std::string formatExtranonce2(uint64_t extranonce2, int size);
+
+    /**
+     * @return the rolled version bits (BIP 310) of the header the core is hashing.
+     */
+    uint32_t getVersionBits(uint32_t core) const;
 
-    uint8_t pickaxe(uint32_t core, uint8_t *hash, uint32_t &winning_nonce);
+    /**
+     * @return true once every extranonce2 has been used, nothing is left to mine in this job.
+     */
+    bool isExhausted() const { return extranonce2_exhausted; }
 
-    void setStartNonce(uint32_t start_nonce);
+    // Version bits the pool lets us roll, 0 when version rolling is off
+    uint32_t version_mask;
+
+#if defined(UNIT_TEST)
+    // Rolls as if the nonce space of the current header was used up, lanes follow on their next pickaxe
+    bool rollExtranonce2() { return rollExtranonce2(generation); }
+    const Block &getHeader() const { return templates[generation & 1].header; }
+#endif
 
 private:
-    void nextNonce(uint32_t core);
-    void generateCoinbaseHash(const std::string &coinbase, std::string &coinbase_hash);
-    void calculateMerkleRoot(const std::string &coinbase_hash, const std::vector<std::string> &merkle_branch, std::string &merkle_root);
-    std::string generate_extra_nonce2(int extranonce2_size);
+    // Header of one extranonce2, rebuilt when its nonce space is exhausted
+    struct Template
+    {
+        nerdSHA256_context sha;
+        uint64_t extranonce2;
+        NonceAllocator nonces;
+        Block header;
+    };
+
+    // Each core hashes its own range with its own copy of the header
+    struct Lane
+    {
+        nerdSHA256_context sha;
+        uint64_t extranonce2;
+        uint32_t generation;
+        uint32_t nonce;
+        uint64_t remaining;
+        uint32_t version;
+        uint32_t version_index;
+    };
 
-    nerdSHA256_context sha;
+    void buildTemplate(Template &slot, Block &header, uint64_t extranonce2);
+    bool rollExtranonce2(uint32_t expected_generation);
+    void syncLane(Lane &lane, uint32_t core);
+    bool claimNonces(Lane &lane);
+    void rollVersion(Lane &lane);
+    void generateCoinbaseHash(uint64_t extranonce2, uint8_t coinbase_hash[SHA256M_BLOCK_SIZE]);
+    void calculateMerkleRoot(const uint8_t coinbase_hash[SHA256M_BLOCK_SIZE], uint8_t merkle_root[SHA256M_BLOCK_SIZE]);
+    uint64_t generate_extra_nonce2();
+    void setVersionCount();
+
+    // Coinbase split around the extranonce2: coinb1 + extranonce1 are kept already hashed,
+    // only extranonce2 + coinb2 are hashed on each rebuild
+    sha256m_context coinbase_prefix;
+    std::vector<uint8_t> coinbase_tail;
+    uint8_t merkle_branch[NOTIFICATION_MERKLE_BRANCHES][NOTIFICATION_HASH_SIZE];
+    size_t merkle_branch_count;
+    int extranonce2_size;
+    uint64_t extranonce2_mask;
+    uint64_t extranonce2_start;
+    uint32_t version_count;
+
+    // Double buffered so a rebuild never touches the header lanes are copying
+    Template templates[2];
+#if defined(ESP8266)
+    uint32_t generation = 0;
+    bool rolling = false;
+#else
+    std::atomic<uint32_t> generation{0};
+    std::atomic<bool> rolling{false};
+#endif
+    bool extranonce2_exhausted = false;
+    Lane lanes[CORE];
     char TAG_JOB[4] = "Job";
     double difficulty;
 };
@@ -1,34 +1,147 @@
 #ifndef NOTIFICATION_H
 #define NOTIFICATION_H
 
-#include <vector>
-#include <string>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/utils.h"
 #include "utils/log.h"
 
+#define TAG_NOTIFICATION "Notification"
+
+#define NOTIFICATION_JOB_ID_SIZE 32
+// coinb1 ends inside the coinbase scriptSig, which consensus caps at 100 bytes, so 256 always fits.
+// coinb2 carries the outputs, which have no cap: larger ones are rejected, logged and counted
+#define NOTIFICATION_COINB1_SIZE 256
+#define NOTIFICATION_COINB2_SIZE 512
+#define NOTIFICATION_MERKLE_BRANCHES 16
+#define NOTIFICATION_HASH_SIZE 32
+
+/**
+ * mining.notify decoded to binary, fixed size so parsing a notify doesn't touch the heap.
+ */
 struct Notification
 {
-    std::string job_id;
-    std::string prevhash;
-    std::string coinb1;
-    std::string coinb2;
-    std::vector<std::string> merkle_branch;
-    std::string version;
-    std::string nbits;
-    std::string ntime;
-    bool clean_jobs;
-
-    // Constructor using member initialization list
-    Notification(const std::string &job_id, const std::string &prevhash, const std::string &coinb1, const std::string &coinb2, const std::vector<std::string> &merkle_branch, const std::string &version, const std::string &nbits, const std::string &ntime, const bool &clean_jobs)
-        : job_id(job_id),
-          prevhash(prevhash),
-          coinb1(coinb1),
-          coinb2(coinb2),
-          merkle_branch(merkle_branch),
-          version(version),
-          nbits(nbits),
-          ntime(ntime),
-          clean_jobs(clean_jobs)
+    char job_id[NOTIFICATION_JOB_ID_SIZE + 1] = {};
+    uint8_t prevhash[NOTIFICATION_HASH_SIZE] = {}; // As sent by the pool
+    uint8_t coinb1[NOTIFICATION_COINB1_SIZE];
+    size_t coinb1_size = 0;
+    uint8_t coinb2[NOTIFICATION_COINB2_SIZE];
+    size_t coinb2_size = 0;
+    uint8_t merkle_branch[NOTIFICATION_MERKLE_BRANCHES][NOTIFICATION_HASH_SIZE];
+    size_t merkle_branch_count = 0;
+    uint32_t version = 0;
+    uint32_t nbits = 0;
+    uint32_t ntime = 0;
+    bool clean_jobs = false;
+
+    /**
+     * Decodes the hex fields of a mining.notify, the merkle branch is added with addMerkleBranch().
+     *
+     * @return false if a field is missing, isn't valid hex or doesn't fit.
+     */
+    bool parse(const char *job_id, const char *prevhash, const char *coinb1, const char *coinb2, const char *version, const char *nbits, const char *ntime, bool clean_jobs)
+    {
+        merkle_branch_count = 0;
+        if (!setHeader(job_id, version, nbits, ntime, clean_jobs))
+        {
+            return false;
+        }
+
+        if (coinb2 != nullptr && strlen(coinb2) / 2 > NOTIFICATION_COINB2_SIZE)
+        {
+            l_error(TAG_NOTIFICATION, "coinb2 of job %s has %u bytes, only %u fit", this->job_id, (unsigned)(strlen(coinb2) / 2), (unsigned)NOTIFICATION_COINB2_SIZE);
+            return false;
+        }
+
+        size_t size;
+        if (!decode(prevhash, this->prevhash, NOTIFICATION_HASH_SIZE, size) || size != NOTIFICATION_HASH_SIZE ||
+            !decode(coinb1, this->coinb1, NOTIFICATION_COINB1_SIZE, coinb1_size) ||
+            !decode(coinb2, this->coinb2, NOTIFICATION_COINB2_SIZE, coinb2_size))
+        {
+            l_error(TAG_NOTIFICATION, "Invalid notify for job %s", this->job_id);
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Sets the short fields of a mining.notify, for when the hex fields were decoded as they were received.
+     *
+     * @return false if the job id is too long or a scalar isn't 8 hex digits.
+     */
+    bool setHeader(const char *job_id, const char *version, const char *nbits, const char *ntime, bool clean_jobs)
+    {
+        this->clean_jobs = clean_jobs;
+
+        if (job_id == nullptr || strlen(job_id) > NOTIFICATION_JOB_ID_SIZE)
+        {
+            l_error(TAG_NOTIFICATION, "Invalid job id");
+            return false;
+        }
+        strcpy(this->job_id, job_id);
+
+        if (!decodeScalar(version, this->version) || !decodeScalar(nbits, this->nbits) || !decodeScalar(ntime, this->ntime))
+        {
+            l_error(TAG_NOTIFICATION, "Invalid notify for job %s", this->job_id);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool addMerkleBranch(const char *branch)
+    {
+        size_t size;
+        if (merkle_branch_count == NOTIFICATION_MERKLE_BRANCHES ||
+            !decode(branch, merkle_branch[merkle_branch_count], NOTIFICATION_HASH_SIZE, size) || size != NOTIFICATION_HASH_SIZE)
+        {
+            l_error(TAG_NOTIFICATION, "Invalid merkle branch for job %s", job_id);
+            return false;
+        }
+        merkle_branch_count++;
+        return true;
+    }
+
+private:
+    static bool isHex(const char *hex, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            const char c = hex[i];
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool decode(const char *hex, uint8_t *output, size_t max_size, size_t &size)
+    {
+        if (hex == nullptr)
+        {
+            return false;
+        }
+        const size_t length = strlen(hex);
+        if (length % 2 != 0 || length / 2 > max_size || !isHex(hex, length))
+        {
+            return false;
+        }
+        hexStringToByteArray(hex, output);
+        size = length / 2;
+        return true;
+    }
+
+    static bool decodeScalar(const char *hex, uint32_t &value)
     {
+        if (hex == nullptr || strlen(hex) != 8 || !isHex(hex, 8))
+        {
+            return false;
+        }
+        value = strtoul(hex, nullptr, 16);
+        return true;
     }
 };
 
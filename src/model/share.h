@@ -0,0 +1,19 @@
+#ifndef SHARE_H
+#define SHARE_H
+
+#include <stdint.h>
+
+/**
+ * A share found by a miner, kept binary until the network side serializes it.
+ * The job is referenced by the epoch it was published in, see current_job_lookup().
+ */
+struct Share
+{
+    uint64_t extranonce2;
+    uint32_t epoch;
+    uint32_t ntime;
+    uint32_t nonce;
+    uint32_t version_bits;
+};
+
+#endif
@@ -2,6 +2,8 @@
 #define TARGET_H
 
 #include <stdio.h>
+#include <string.h>
+#include "utils/utils.h"
 
 class Target
 {
@@ -23,13 +25,29 @@ public:
         uint32_t bits_value = strtoul(nbits, &endPtr, 16);
 
         // Check for conversion errors
-        if (*endPtr != '\0' || bits_value == 0)
+        if (*endPtr != '\0')
         {
             // Handle the error (print a message, set a default value, etc.).
             Serial.println("Error: Invalid nbits value");
             return;
         }
 
+        calculate(bits_value);
+    }
+
+    /**
+     * Same as calculate(const char *), for nbits already decoded.
+     *
+     * @param bits_value The nbits value.
+     */
+    void calculate(uint32_t bits_value)
+    {
+        if (bits_value == 0)
+        {
+            Serial.println("Error: Invalid nbits value");
+            return;
+        }
+
         // Extract the exponent and mantissa from bits_value.
         uint32_t exp = bits_value >> EXPONENT_SHIFT;
         uint32_t mant = bits_value & MANTISSA_MASK;
@@ -48,6 +66,43 @@ public:
         value[sb + 3] = (mant >> (24 - rb));
     }
 
+    /**
+     * Calculates the share target for a pool difficulty, as a little-endian 256-bit value.
+     * The target is TRUEDIFFONE / difficulty, split in four 64-bit words from the most significant one.
+     * It is meant to be done once when the difficulty changes, so that candidates can be checked
+     * with an integer compare instead of converting every hash to a double.
+     *
+     * @param difficulty The pool difficulty, values <= 0 accept every hash.
+     */
+    void fromDifficulty(double difficulty)
+    {
+        if (difficulty <= 0)
+        {
+            memset(value, 0xff, sizeof(value));
+            return;
+        }
+
+        const double scales[4] = {BITS192, BITS128, BITS64, 1.0};
+        double remainder = TRUEDIFFONE / difficulty;
+
+        for (int i = 0; i < 4; i++)
+        {
+            const double quotient = remainder / scales[i];
+            // Difficulties below the minimum overflow the 256 bits, saturate them
+            const uint64_t word = (quotient >= BITS64) ? UINT64_MAX : (uint64_t)quotient;
+            remainder -= (double)word * scales[i];
+            if (remainder < 0)
+            {
+                remainder = 0;
+            }
+
+            for (int b = 0; b < 8; b++)
+            {
+                value[(3 - i) * 8 + b] = (uint8_t)(word >> (8 * b));
+            }
+        }
+    }
+
 private:
     static const uint32_t EXPONENT_SHIFT = 24;
     static const uint32_t MANTISSA_MASK = 0xffffff;
@@ -0,0 +1,52 @@
+#include "network/inflight.h"
+
+void InflightTable::add(uint64_t id, InflightMethod method, uint32_t sent, uint32_t epoch, uint32_t nonce)
+{
+    InflightRequest &request = requests[id % INFLIGHT_SIZE];
+    if (request.method != INFLIGHT_NONE)
+    {
+        lost++;
+        pending--;
+    }
+    request = {id, method, sent, epoch, nonce};
+    pending++;
+}
+
+bool InflightTable::take(uint64_t id, InflightRequest &request)
+{
+    InflightRequest &slot = requests[id % INFLIGHT_SIZE];
+    if (slot.method == INFLIGHT_NONE || slot.id != id)
+    {
+        return false;
+    }
+    request = slot;
+    slot.method = INFLIGHT_NONE;
+    pending--;
+    return true;
+}
+
+uint32_t InflightTable::expire(uint32_t now, uint32_t timeout)
+{
+    uint32_t expired = 0;
+    for (uint32_t i = 0; i < INFLIGHT_SIZE; i++)
+    {
+        InflightRequest &request = requests[i];
+        if (request.method != INFLIGHT_NONE && now - request.sent > timeout)
+        {
+            request.method = INFLIGHT_NONE;
+            expired++;
+        }
+    }
+    pending -= expired;
+    lost += expired;
+    return expired;
+}
+
+void InflightTable::clear()
+{
+    for (uint32_t i = 0; i < INFLIGHT_SIZE; i++)
+    {
+        requests[i].method = INFLIGHT_NONE;
+    }
+    pending = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef INFLIGHT_H
+#define INFLIGHT_H
+
+#include <stdint.h>
+
+#define INFLIGHT_SIZE 16 // Requests waiting for a response, ids are sequential so a slot is id % size
+
+enum InflightMethod : uint8_t
+{
+    INFLIGHT_NONE = 0,
+    INFLIGHT_CONFIGURE,
+    INFLIGHT_SUBSCRIBE,
+    INFLIGHT_AUTHORIZE,
+    INFLIGHT_SUGGEST_DIFFICULTY,
+    INFLIGHT_SUBMIT,
+};
+
+struct InflightRequest
+{
+    uint64_t id;
+    InflightMethod method;
+    uint32_t sent;  // millis() when the request was written
+    uint32_t epoch; // Submits: epoch of the share's job
+    uint32_t nonce; // Submits: nonce of the share
+};
+
+/**
+ * Requests sent to the pool and not answered yet, so every response is matched to its request by id.
+ * Only the network side uses it.
+ */
+class InflightTable
+{
+public:
+    /**
+     * Records a sent request. A request still waiting in the same slot, INFLIGHT_SIZE ids older, is forgotten.
+     */
+    void add(uint64_t id, InflightMethod method, uint32_t sent, uint32_t epoch = 0, uint32_t nonce = 0);
+
+    /**
+     * Removes the request answered by a response.
+     *
+     * @return false if the id was never sent, already answered or forgotten.
+     */
+    bool take(uint64_t id, InflightRequest &request);
+
+    /**
+     * Forgets the requests sent more than timeout ms before now.
+     *
+     * @return how many were forgotten.
+     */
+    uint32_t expire(uint32_t now, uint32_t timeout);
+
+    void clear();
+
+    uint32_t getPending() const { return pending; }
+    uint32_t getLost() const { return lost; }
+
+private:
+    InflightRequest requests[INFLIGHT_SIZE] = {};
+    uint32_t pending = 0;
+    uint32_t lost = 0; // Overwritten or expired without a response
+};
+
+#endif // INFLIGHT_H
@@ -11,16 +11,23 @@
 #include "utils/log.h"                // Funções de log (l_info, l_error, l_debug)
 #include "leafminer.h"                // Funções específicas do LeafMiner
 #include "current.h"                  // Funções/variáveis para gerenciamento do trabalho atual
+#include "network/sharering.h"        // Fila de shares entre os miners e a rede
+#include "network/stratum.h"          // Parser incremental das mensagens do pool
+#include "network/inflight.h"         // Requisições esperando resposta do pool
+#include "network/submit.h"           // mining.submit pré-montado por job
 #include "model/configuration.h"      // (Incluído novamente possivelmente por necessidade de compatibilidade)
 
 // Define constantes para o tamanho dos buffers e tempos de espera
-#define NETWORK_BUFFER_SIZE 2048      // Tamanho do buffer para leitura de dados da rede
-#define NETWORK_TIMEOUT 1000 * 60       // Tempo de timeout (em milissegundos)
-#define NETWORK_DELAY 1222              // Um delay fixo usado entre tentativas (em milissegundos)
-#define NETWORK_WIFI_ATTEMPTS 2         // Número máximo de tentativas para conectar ao WiFi
-#define NETWORK_STRATUM_ATTEMPTS 2      // Número máximo de tentativas para conectar ao host (pool)
-#define MAX_PAYLOAD_SIZE 256            // Tamanho máximo de um payload (mensagem) em bytes
-#define MAX_PAYLOADS 10                 // Número máximo de payloads que podem ser enfileirados
+#define NETWORK_BUFFER_SIZE 256       // Tamanho de cada leitura, o parser guarda o estado entre leituras
+#define NETWORK_OUTBOUND_SIZE 1024      // Mensagens de um passo da rede, enviadas juntas em uma escrita
+#define NETWORK_WIFI_TIMEOUT 10000      // Tempo máximo para o WiFi conectar (em milissegundos)
+#define NETWORK_RESPONSE_TIMEOUT 10000  // Tempo máximo para o pool responder subscribe e authorize
+#define NETWORK_DNS_TIMEOUT 2000        // Tempo máximo da consulta DNS no ESP8266
+#define NETWORK_CONNECT_TIMEOUT 2000    // Tempo máximo para abrir o socket com o pool
+#define NETWORK_BACKOFF_MIN 1000        // Espera depois da primeira falha, dobra a cada nova falha
+#define NETWORK_BACKOFF_MAX 1000 * 60   // Espera máxima entre tentativas
+#define NETWORK_WIFI_ATTEMPTS 2         // Número máximo de tentativas para conectar ao WiFi no boot
+#define NETWORK_STRATUM_ATTEMPTS 2      // Número máximo de tentativas para conectar ao host (pool) no boot
 
 // Cria uma instância do objeto WiFiClient para gerenciar a conexão TCP
 WiFiClient client = WiFiClient();
@@ -30,17 +37,55 @@ char TAG_NETWORK[8] = "Network";
 
 // Variáveis globais para gerenciamento de IDs e estado de conexão
 uint64_t id = 0;                      // Contador global para geração de IDs únicos
-uint64_t requestJobId = 0;            // ID da requisição de trabalho atual
-uint8_t isRequestingJob = 0;          // Flag indicando se já está solicitando um trabalho
-uint32_t authorizeId = 0;             // ID usado na autorização
 uint8_t isAuthorized = 0;             // Flag indicando se a autorização foi bem-sucedida
 
 // Declaração externa da configuração (definida em outro módulo)
 extern Configuration configuration;
 
-// Array de strings para armazenar payloads enfileirados e contador
-char payloads[MAX_PAYLOADS][MAX_PAYLOAD_SIZE]; // Armazena mensagens a serem enviadas
-size_t payloads_count = 0;            // Número de payloads atualmente enfileirados
+// Um anel de shares por miner, o JSON só é montado aqui na hora de enviar
+ShareRing shares[CORE];
+
+// mining.notify decodificados, estáticos para não alocar a cada notify. Um guarda o último válido
+// da rajada de leitura atual, o outro recebe o próximo
+Notification notifications[2];
+uint8_t notification_next = 0;        // Índice onde o próximo notify é decodificado
+bool notification_pending = false;    // Há um notify válido esperando o fim da rajada
+
+// Parser das mensagens recebidas, uma mensagem pode chegar em várias leituras
+StratumParser stratum;
+
+// Requisições enviadas e ainda sem resposta, cada resposta é ligada à sua pelo id
+InflightTable inflight;
+
+// mining.submit dos jobs que ainda aceitam shares, um por posição do histórico de jobs
+SubmitTemplate submits[CURRENT_JOB_HISTORY];
+
+// Mensagens esperando o fim do passo da rede, saem todas em um client.write()
+char outbound[NETWORK_OUTBOUND_SIZE];
+size_t outbound_length = 0;
+uint32_t network_bytes_sent = 0;      // Bytes entregues ao socket
+uint32_t network_write_calls = 0;     // Chamadas a client.write(), cada uma vira um ou mais segmentos TCP (MSS)
+uint32_t network_notify_oversized = 0; // Notifies descartados por um coinbase maior que os buffers da Notification
+
+// Estados da conexão com o pool, na ordem em que são percorridos
+enum network_state_t : uint8_t
+{
+    NETWORK_DISCONNECTED,             // Nada aberto, começa pelo WiFi
+    NETWORK_WIFI,                     // WiFi.begin chamado, esperando conectar
+    NETWORK_DNS,                      // Resolve o host do pool
+    NETWORK_TCP,                      // Abre o socket com o pool
+    NETWORK_SUBSCRIBING,              // configure e subscribe enviados, esperando a resposta
+    NETWORK_AUTHORIZING,              // authorize enviado, esperando a resposta
+    NETWORK_MINING,                   // Sessão pronta, recebe jobs e envia shares
+    NETWORK_BACKOFF,                  // Falhou, espera network_backoff antes de tentar de novo
+};
+
+network_state_t network_state = NETWORK_DISCONNECTED;
+uint32_t network_state_since = 0;     // millis() de quando entrou no estado atual
+uint32_t network_backoff = 0;         // Espera atual entre tentativas, zera quando a sessão fica pronta
+uint8_t network_wifi_failures = 0;    // Falhas seguidas do WiFi
+uint8_t network_pool_failures = 0;    // Falhas seguidas do pool
+IPAddress network_pool_ip;
 
 /**
  * @brief Gera o próximo ID para as requisições de rede.
@@ -55,85 +100,78 @@ uint64_t nextId()
 }
 
 /**
- * @brief Verifica se o dispositivo está conectado à rede WiFi e ao host.
+ * @brief O ID que o próximo nextId() vai gerar, sem consumi-lo.
+ */
+uint64_t peekId()
+{
+    return (id == UINT64_MAX) ? 1 : id + 1;
+}
+
+/**
+ * @brief Gera o ID de uma requisição e a registra na tabela, a resposta é reconhecida por ele.
  *
- * Se não estiver conectado, tenta reconectar ao WiFi e ao host (pool).
+ * @param method O método da requisição.
+ * @param epoch Para shares, a época do job.
+ * @param nonce Para shares, o nonce.
+ * @return O ID da requisição.
+ */
+uint64_t track(InflightMethod method, uint32_t epoch = 0, uint32_t nonce = 0)
+{
+    const uint64_t next_id = nextId();
+    inflight.add(next_id, method, millis(), epoch, nonce);
+    return next_id;
+}
+
+/**
+ * @brief Escreve no socket tudo o que foi acumulado por request().
  *
- * @return 1 se conectado com sucesso, -1 em caso de falha.
+ * O que o socket não aceitar agora fica para o próximo passo.
  */
-short isConnected()
+void network_flush()
 {
-    // Se já estiver conectado ao WiFi e o cliente TCP estiver conectado, retorna sucesso.
-    if (WiFi.status() == WL_CONNECTED && client.connected())
+    if (outbound_length == 0)
     {
-        return 1;
+        return;
     }
 
-    uint16_t wifi_attemps = 0;
+    const size_t written = client.write((const uint8_t *)outbound, outbound_length);
+    network_write_calls++;
+    network_bytes_sent += written;
+    l_debug(TAG_NETWORK, "Sent %u of %u bytes (%lu bytes in %lu writes)", (unsigned)written, (unsigned)outbound_length,
+            (unsigned long)network_bytes_sent, (unsigned long)network_write_calls);
 
-    // Tenta conectar ao WiFi até NETWORK_WIFI_ATTEMPTS vezes.
-    while (wifi_attemps < NETWORK_WIFI_ATTEMPTS)
+    outbound_length -= written;
+    if (outbound_length > 0)
     {
-        l_info(TAG_NETWORK, "Connecting to %s...", configuration.wifi_ssid.c_str());
-        WiFi.begin(configuration.wifi_ssid.c_str(), configuration.wifi_password.c_str());
-        wifi_attemps++;
-        delay(500);
-        // Se a conexão for bem-sucedida, sai do loop.
-        if (WiFi.waitForConnectResult() == WL_CONNECTED)
-        {
-            break;
-        }
-        delay(1500);
+        memmove(outbound, outbound + written, outbound_length);
     }
-
-    // Se mesmo após as tentativas não estiver conectado, exibe erro e retorna -1.
-    if (WiFi.waitForConnectResult() != WL_CONNECTED)
-    {
-        l_error(TAG_NETWORK, "Unable to connect to WiFi");
-        return -1;
-    }
-
-    // Conexão WiFi estabelecida. Loga informações de rede.
-    l_info(TAG_NETWORK, "Connected to WiFi");
-    l_info(TAG_NETWORK, "IP address: %s", WiFi.localIP().toString().c_str());
-    l_info(TAG_NETWORK, "MAC address: %s", WiFi.macAddress().c_str());
-
-    uint16_t wifi_stratum = 0;
-
-    // Tenta conectar ao host (pool) com NETWORK_STRATUM_ATTEMPTS tentativas.
-    while (wifi_stratum < NETWORK_STRATUM_ATTEMPTS)
-    {
-        l_debug(TAG_NETWORK, "Connecting to host %s...", configuration.pool_url.c_str());
-        client.connect(configuration.pool_url.c_str(), configuration.pool_port);
-        delay(500);
-        if (client.connected())
-        {
-            break;
-        }
-        wifi_stratum++;
-        delay(1000);
-    }
-
-    // Se não conseguir conectar ao host, retorna erro.
-    if (!client.connected())
-    {
-        l_error(TAG_NETWORK, "Unable to connect to host");
-        return -1;
-    }
-
-    return 1;
 }
 
 /**
  * @brief Envia um payload (mensagem) para o servidor.
  *
- * A função envia o payload pela conexão TCP e registra a mensagem enviada via log.
+ * O payload é acumulado e sai junto com os outros do mesmo passo da rede, em network_flush().
+ * Se não couber, a requisição sai da tabela, nenhuma resposta vai chegar para ela.
  *
  * @param payload A mensagem (payload) a ser enviada.
+ * @param id O ID da requisição, registrado por track().
  */
-void request(const char *payload)
+void request(const char *payload, uint64_t id)
 {
-    client.print(payload);               // Envia o payload através do cliente TCP
+    const size_t length = strlen(payload);
+    if (outbound_length + length > NETWORK_OUTBOUND_SIZE)
+    {
+        network_flush();                 // Sem espaço, esvazia antes
+    }
+    if (outbound_length + length > NETWORK_OUTBOUND_SIZE)
+    {
+        l_error(TAG_NETWORK, "Outbound buffer full, message %llu dropped", id);
+        InflightRequest dropped;
+        inflight.take(id, dropped);
+        return;
+    }
+    memcpy(outbound + outbound_length, payload, length);
+    outbound_length += length;
     l_info(TAG_NETWORK, ">>> %s", payload); // Loga a mensagem enviada
 }
 
@@ -145,15 +183,38 @@ void request(const char *payload)
 void authorize()
 {
     char payload[1024];
-    uint64_t next_id = nextId();         // Gera o próximo ID para a requisição
+    uint64_t next_id = track(INFLIGHT_AUTHORIZE); // Gera o próximo ID para a requisição
     isAuthorized = 0;                    // Reseta a flag de autorização
-    authorizeId = next_id;               // Armazena o ID usado para autorização
     // Monta a mensagem JSON de autorização
     sprintf(payload, "{\"id\":%llu,\"method\":\"mining.authorize\",\"params\":[\"%s\",\"%s\"]}\n", 
             next_id, 
             configuration.wallet_address.c_str(), 
             configuration.pool_password.c_str());
-    request(payload);                    // Envia a mensagem
+    request(payload, next_id);           // Envia a mensagem
+}
+
+/**
+ * @brief Negocia o version rolling (BIP 310) com o pool.
+ *
+ * Pede a máscara MINING_VERSION_ROLLING_MASK, a resposta define quais bits da versão podem ser alterados.
+ */
+void configure()
+{
+    char payload[1024];
+    uint64_t next_id = track(INFLIGHT_CONFIGURE);
+    sprintf(payload, "{\"id\":%llu,\"method\":\"mining.configure\",\"params\":[[\"version-rolling\"],{\"version-rolling.mask\":\"%08x\",\"version-rolling.min-bit-count\":%d}]}\n",
+            next_id,
+            MINING_VERSION_ROLLING_MASK,
+            MINING_VERSION_ROLLING_MIN_BITS);
+    request(payload, next_id);           // Envia a mensagem
+}
+
+/**
+ * @brief Lê uma máscara de versão em hex, limitada aos bits pedidos ao pool.
+ */
+uint32_t versionMask(const char *mask)
+{
+    return strtoul(mask, nullptr, 16) & MINING_VERSION_ROLLING_MASK;
 }
 
 /**
@@ -164,10 +225,11 @@ void authorize()
 void subscribe()
 {
     char payload[1024];
+    uint64_t next_id = track(INFLIGHT_SUBSCRIBE);
     // Monta a mensagem JSON para subscribe usando a versão do software (_VERSION)
     sprintf(payload, "{\"id\":%llu,\"method\":\"mining.subscribe\",\"params\":[\"LeafMiner/%s\", null]}\n", 
-            nextId(), _VERSION);
-    request(payload);                    // Envia a mensagem
+            next_id, _VERSION);
+    request(payload, next_id);           // Envia a mensagem
 }
 
 /**
@@ -178,412 +240,616 @@ void subscribe()
 void difficulty()
 {
     char payload[1024];
+    uint64_t next_id = track(INFLIGHT_SUGGEST_DIFFICULTY);
     // Monta a mensagem JSON passando a dificuldade (valor double)
     sprintf(payload, "{\"id\":%llu,\"method\":\"mining.suggest_difficulty\",\"params\":[%f]}\n", 
-            nextId(), DIFFICULTY);
-    request(payload);                    // Envia a mensagem
+            next_id, DIFFICULTY);
+    request(payload, next_id);           // Envia a mensagem
 }
 
 /**
  * @brief Determina o tipo de resposta recebido do pool.
  *
- * Analisa o objeto JSON e retorna uma string representando o tipo de resposta.
+ * Notificações trazem o método. Respostas são ligadas à requisição pelo id, na tabela de requisições em andamento.
  *
- * @param json O objeto cJSON que representa a resposta.
+ * @param message A mensagem decodificada pelo StratumParser.
+ * @param sent Recebe a requisição respondida.
  * @return Uma string com o tipo de resposta (ex.: "subscribe", "mining.notify", etc.)
  */
-const char *responseType(cJSON *json)
+const char *responseType(const StratumMessage &message, InflightRequest &sent)
 {
-    const cJSON *result = cJSON_GetObjectItem(json, "result");
-    if (result != NULL && cJSON_IsArray(result) && cJSON_GetArraySize(result) > 0)
+    if (message.method[0] != '\0')
     {
-        const cJSON *item0 = cJSON_GetArrayItem(result, 0);
-        if (item0 != NULL && cJSON_IsArray(item0) && cJSON_GetArraySize(item0) > 0)
-        {
-            const cJSON *item00 = cJSON_GetArrayItem(item0, 0);
-            if (item00 != NULL && cJSON_IsArray(item00) && cJSON_GetArraySize(item00) > 0)
-            {
-                return "subscribe";         // Identifica resposta de inscrição
-            }
-        }
+        // Se existir a chave "method", retorna seu valor
+        return message.method;
     }
-    else if (cJSON_HasObjectItem(json, "method"))
+    if (!message.has_id || !inflight.take(message.id, sent))
     {
-        // Se existir a chave "method", retorna seu valor
-        return cJSON_GetStringValue(cJSON_GetObjectItem(json, "method"));
+        return "unknown";               // Resposta de uma requisição que não está na tabela
     }
-    else if (cJSON_HasObjectItem(json, "result"))
+
+    switch (sent.method)
     {
-        const cJSON *result = cJSON_GetObjectItem(json, "result");
-        // Verifica se o ID da mensagem corresponde ao authorizeId para identificar autorização
-        if (authorizeId == cJSON_GetNumberValue(cJSON_GetObjectItem(json, "id")))
+    case INFLIGHT_CONFIGURE:
+        return "configured";            // Resposta do mining.configure, aceita ou não pelo pool
+    case INFLIGHT_SUBSCRIBE:
+        return "subscribe";
+    case INFLIGHT_AUTHORIZE:
+        return "authorized";
+    case INFLIGHT_SUGGEST_DIFFICULTY:
+        return "difficulty";
+    case INFLIGHT_SUBMIT:
+        if (message.result_true)
         {
-            return "authorized";
+            return "mining.submit";       // Resposta positiva para um share submetido
         }
-        if (cJSON_IsTrue(result))
+        // "Job not found" (código 21): o share era de um job que o pool já descartou
+        if (message.error_code == 21)
         {
-            return "mining.submit";       // Resposta positiva para um share submetido
+            return "mining.submit.stale";
         }
-        else
+        if (message.error_code == 23)
         {
-            // Se o erro é "Job not found" (código 21), identifica como falha na submissão
-            if (cJSON_GetNumberValue(cJSON_GetArrayItem(cJSON_GetObjectItem(json, "error"), 0)) == 21)
-            {
-                return "mining.submit.fail";
-            }
-            else if (cJSON_GetNumberValue(cJSON_GetArrayItem(cJSON_GetObjectItem(json, "error"), 0)) == 23)
-            {
-                return "mining.submit.difficulty_too_low";
-            }
-            else
-            {
-                return "mining.submit";
-            }
+            return "mining.submit.difficulty_too_low";
         }
+        return "mining.submit.rejected";
+    default:
+        return "unknown";
     }
-
-    return "unknown";                   // Caso não se encaixe em nenhum tipo conhecido
 }
 
 /**
- * @brief Processa a resposta recebida do pool.
+ * @brief Processa uma mensagem recebida do pool.
  *
- * Faz o parse do JSON e executa ações conforme o tipo de resposta.
+ * Chamada pelo StratumParser quando uma mensagem termina, executa ações conforme o tipo de resposta.
+ * Os campos hex de um mining.notify já foram decodificados em notifications[notification_next].
  *
- * @param r A resposta recebida (std::string).
+ * @param message A mensagem decodificada.
  */
-void response(std::string r)
+void response(StratumMessage &message)
 {
-    cJSON *json = cJSON_Parse(r.c_str());
-    const char *type = responseType(json);
-    l_info(TAG_NETWORK, "<<< [%s] %s", type, r.c_str());
+    InflightRequest sent = {};
+    const char *type = responseType(message, sent);
+    const uint32_t latency = millis() - sent.sent;
+    l_info(TAG_NETWORK, "<<< [%s] %llu", type, message.id);
 
     if (strcmp(type, "subscribe") == 0)
     {
         // Trata a resposta de inscrição (subscribe)
-        const cJSON *result = cJSON_GetObjectItem(json, "result");
-        if (cJSON_IsArray(result) && cJSON_IsArray(cJSON_GetArrayItem(result, 0)) &&
-            cJSON_IsArray(cJSON_GetArrayItem(cJSON_GetArrayItem(result, 0), 0)))
+        if (message.is_subscribe && message.subscription_id[0] != '\0' && message.extranonce1[0] != '\0' && message.extranonce2_size > 0)
         {
-            const cJSON *subscribeIdJson = cJSON_GetArrayItem(cJSON_GetArrayItem(cJSON_GetArrayItem(result, 0), 0), 1);
-            const cJSON *extranonce1Json = cJSON_GetArrayItem(result, 1);
-            const cJSON *extranonce2SizeJson = cJSON_GetArrayItem(result, 2);
-
-            if (cJSON_IsString(subscribeIdJson) && cJSON_IsString(extranonce1Json) && cJSON_IsNumber(extranonce2SizeJson))
-            {
-                std::string subscribeId = subscribeIdJson->valuestring;
-                std::string extranonce1 = extranonce1Json->valuestring;
-                int extranonce2_size = extranonce2SizeJson->valueint;
-                // Cria um novo objeto Subscribe com os valores recebidos
-                Subscribe *subscribe = new Subscribe(subscribeId, extranonce1, extranonce2_size);
-                current_setSubscribe(subscribe);
-            }
+            // Cria um novo objeto Subscribe com os valores recebidos
+            Subscribe *subscribe = new Subscribe(message.subscription_id, message.extranonce1, message.extranonce2_size);
+            current_setSubscribe(subscribe);
         }
     }
     else if (strcmp(type, "mining.notify") == 0)
     {
         // Trata a notificação de novo trabalho (job) para mineração
-        cJSON *params = cJSON_GetObjectItem(json, "params");
-        std::string job_id = cJSON_GetArrayItem(params, 0)->valuestring;
+        if (message.param_count != 9)
+        {
+            l_error(TAG_NETWORK, "Invalid notify");
+            return;
+        }
+        const char *job_id = message.param_type[0] == STRATUM_STRING ? message.param_text[0] : nullptr;
 
-        // Verifica se o job recebido é igual ao job atual para evitar processamento duplicado
-        if (current_hasJob() && strcmp(current_job->job_id.c_str(), job_id.c_str()) == 0)
+        // Verifica se o job recebido é igual ao atual (ou ao pendente) para evitar processamento duplicado.
+        // O job mantido de uma sessão anterior não conta, o pool pode repetir o id
+        const Notification &pending = notifications[notification_next ^ 1];
+        if (job_id != nullptr && ((current_hasSessionJob() && strcmp(current_getJobId(), job_id) == 0) ||
+                                  (notification_pending && strcmp(pending.job_id, job_id) == 0)))
         {
             l_error(TAG_NETWORK, "Job is the same as the current one");
             return;
         }
 
-        if (cJSON_IsArray(params) && cJSON_GetArraySize(params) == 9)
+        // prevhash, coinb1, coinb2 e o merkle branch foram decodificados enquanto chegavam, falta o resto
+        Notification &notification = notifications[notification_next];
+        const bool valid = message.notification_valid &&
+                           message.param_type[1] != STRATUM_NONE && message.param_type[2] != STRATUM_NONE &&
+                           message.param_type[3] != STRATUM_NONE && message.param_type[4] == STRATUM_ARRAY &&
+                           notification.setHeader(job_id,
+                                                  message.param_type[5] == STRATUM_STRING ? message.param_text[5] : nullptr,
+                                                  message.param_type[6] == STRATUM_STRING ? message.param_text[6] : nullptr,
+                                                  message.param_type[7] == STRATUM_STRING ? message.param_text[7] : nullptr,
+                                                  message.param_type[8] == STRATUM_BOOL && message.param_bool[8]);
+        if (!valid)
         {
-            // Extrai os parâmetros do novo trabalho
-            std::string prevhash = cJSON_GetArrayItem(params, 1)->valuestring;
-            std::string coinb1 = cJSON_GetArrayItem(params, 2)->valuestring;
-            std::string coinb2 = cJSON_GetArrayItem(params, 3)->valuestring;
-            cJSON *merkle_branch = cJSON_GetArrayItem(params, 4);
-            std::string version = cJSON_GetArrayItem(params, 5)->valuestring;
-            std::string nbits = cJSON_GetArrayItem(params, 6)->valuestring;
-            std::string ntime = cJSON_GetArrayItem(params, 7)->valuestring;
-            bool clean_jobs = cJSON_GetArrayItem(params, 8)->valueint == 1;
-
-            // Converte o merkle branch para um vetor de strings
-            std::vector<std::string> merkleBranchStrings;
-            int merkleBranchSize = cJSON_GetArraySize(merkle_branch);
-            for (int i = 0; i < merkleBranchSize; ++i)
+            if (message.coinbase_oversized)
             {
-                merkleBranchStrings.push_back(cJSON_GetArrayItem(merkle_branch, i)->valuestring);
+                network_notify_oversized++;
+                l_error(TAG_NETWORK, "Notify %s dropped, coinbase too large (%lu so far)", job_id != nullptr ? job_id : "?", (unsigned long)network_notify_oversized);
+                return;
             }
-            requestJobId = nextId();
+            l_error(TAG_NETWORK, "Invalid notify");
+            return;
+        }
 
-            // Define o novo job atual com os dados recebidos
-            current_setJob(Notification(job_id, prevhash, coinb1, coinb2, merkleBranchStrings, version, nbits, ntime, clean_jobs));
-            isRequestingJob = 0;
+        // O job só é montado no fim da rajada, um notify mais novo substitui este.
+        // Se o anterior pedia clean_jobs, o mais novo herda, os jobs antigos continuam inválidos
+        notification.clean_jobs = notification.clean_jobs || (notification_pending && pending.clean_jobs);
+        if (notification_pending)
+        {
+            l_debug(TAG_NETWORK, "Notify %s superseded by %s", pending.job_id, notification.job_id);
         }
+        notification_pending = true;
+        notification_next ^= 1;
+        stratum.setNotification(&notifications[notification_next]);
     }
     else if (strcmp(type, "mining.set_difficulty") == 0)
     {
         // Trata a mensagem para alterar a dificuldade de mineração
-        const cJSON *paramsArray = cJSON_GetObjectItem(json, "params");
-        if (cJSON_IsArray(paramsArray) && cJSON_GetArraySize(paramsArray) == 1)
+        if (message.param_count == 1 && message.param_type[0] == STRATUM_NUMBER)
         {
-            const cJSON *difficultyItem = cJSON_GetArrayItem(paramsArray, 0);
-            if (cJSON_IsNumber(difficultyItem))
-            {
-                double diff = difficultyItem->valuedouble;
-                current_setDifficulty(diff);
-                l_debug(TAG_NETWORK, "Difficulty set to: %.10f", diff);
-            }
+            double diff = message.param_number[0];
+            current_setDifficulty(diff);
+            l_debug(TAG_NETWORK, "Difficulty set to: %.10f", diff);
+        }
+    }
+    else if (strcmp(type, "configured") == 0)
+    {
+        // Version rolling só fica ativo se o pool aceitar e devolver uma máscara
+        uint32_t mask = 0;
+        if (message.version_rolling)
+        {
+            mask = versionMask(message.version_mask);
+        }
+        if (mask == 0)
+        {
+            l_info(TAG_NETWORK, "Version rolling not supported by the pool");
+        }
+        current_setVersionMask(mask);
+    }
+    else if (strcmp(type, "mining.set_version_mask") == 0)
+    {
+        // O pool pode mudar a máscara durante a sessão, o job atual e a fila já passam a usá-la
+        if (message.param_count == 1 && message.param_type[0] == STRATUM_STRING)
+        {
+            current_setVersionMask(versionMask(message.param_text[0]));
         }
     }
     else if (strcmp(type, "authorized") == 0)
     {
         // Se a resposta indicar autorização, registra o sucesso
+        if (!message.result_true)
+        {
+            l_error(TAG_NETWORK, "Authorization refused by the pool");
+            return;
+        }
         l_info(TAG_NETWORK, "Authorized");
         isAuthorized = 1;
     }
+    else if (strcmp(type, "difficulty") == 0)
+    {
+        // A sugestão é só uma sugestão, a dificuldade vem no mining.set_difficulty
+        l_debug(TAG_NETWORK, "Difficulty suggestion answered");
+    }
     else if (strcmp(type, "mining.submit") == 0)
     {
         // Se um share submetido foi aceito
-        l_info(TAG_NETWORK, "Share accepted");
+        l_info(TAG_NETWORK, "Share 0x%08x accepted in %lu ms", sent.nonce, (unsigned long)latency);
         current_increment_hash_accepted();
     }
     else if (strcmp(type, "mining.submit.difficulty_too_low") == 0)
     {
         // Se o share foi rejeitado por dificuldade baixa
-        l_error(TAG_NETWORK, "Share rejected due to low difficulty");
+        l_error(TAG_NETWORK, "Share 0x%08x rejected due to low difficulty", sent.nonce);
         current_increment_hash_rejected();
     }
-    else if (strcmp(type, "mining.submit.fail") == 0)
+    else if (strcmp(type, "mining.submit.stale") == 0)
     {
-        // Se o share foi rejeitado
-        l_error(TAG_NETWORK, "Share rejected");
+        l_error(TAG_NETWORK, "Share 0x%08x rejected, job not found", sent.nonce);
+        current_increment_hash_rejected();
 
-        // Se a resposta veio com um ID menor que o do requestJobId, ignora a resposta tardia
-        if ((uint64_t)cJSON_GetObjectItem(json, "id")->valueint < requestJobId)
+        // Só o job que está sendo minerado é descartado, shares de jobs anteriores não dizem nada sobre ele
+        const current_job_info *job = current_job_lookup(sent.epoch);
+        if (job != nullptr && current_hasJob() && strcmp(job->job_id, current_getJobId()) == 0)
         {
-            l_error(TAG_NETWORK, "Late responses, skip them");
-        }
-        else
-        {
-            current_job_is_valid = 0;
-#if defined(ESP32)
-            if (current_job_next != nullptr)
-            {
-                current_job = current_job_next;
-                current_job_next = nullptr;
-                current_job_is_valid = 1;
-                l_debug(TAG_NETWORK, "Job (next): %s ready to be mined", current_job->job_id.c_str());
-                current_increment_processedJob();
-            }
-#endif
-            current_increment_hash_rejected();
+            // O pool não conhece mais o job, passa para o próximo da fila ou espera o próximo notify
+            current_job_invalidate();
         }
     }
+    else if (strcmp(type, "mining.submit.rejected") == 0)
+    {
+        l_error(TAG_NETWORK, "Share 0x%08x rejected, error %d", sent.nonce, message.error_code);
+        current_increment_hash_rejected();
+    }
     else
     {
         // Se o tipo de resposta não for reconhecido, registra erro
         l_error(TAG_NETWORK, "Unknown response type: %s", type);
     }
-    // Libera o objeto JSON para evitar vazamento de memória
-    cJSON_Delete(json);
-    // Limpa a string de resposta
-    r.clear();
 }
 
 /**
- * @brief Solicita um novo trabalho (job) para mineração.
+ * @brief Monta o job do último notify recebido, chamado quando a rajada de leitura termina.
+ */
+void applyNotification()
+{
+    if (!notification_pending)
+    {
+        return;
+    }
+    notification_pending = false;
+
+    // Define o novo job atual com os dados recebidos
+    current_setJob(notifications[notification_next ^ 1]);
+}
+
+/**
+ * @brief Monta o mining.submit de um share.
  *
- * Se já houver um job válido ou uma requisição em andamento, não solicita novamente.
- * Se não estiver conectado, reinicia a sessão.
+ * O job é encontrado pela época em que foi publicado, um share de um job que já saiu do histórico
+ * ou que veio de uma sessão anterior é descartado.
+ * O payload de cada job é montado no primeiro share, nos seguintes só o ID, extranonce2, nonce e versão são escritos.
  *
- * @return 1 se a requisição foi iniciada, -1 em caso de falha.
+ * @param share O share em formato binário.
+ * @param id Recebe o ID da requisição.
+ * @return O payload, ou nullptr se o job do share não existe mais.
  */
-short network_getJob()
+const char *serializeShare(const Share &share, uint64_t &id)
 {
-    if (current_job_is_valid == 1)
+    const current_job_info *job = current_job_lookup(share.epoch);
+    if (job == nullptr)
     {
-        l_info(TAG_NETWORK, "Already has a job and don't need a new one");
-        return 0;
+        l_error(TAG_NETWORK, "Share 0x%08x of an old job, dropped", share.nonce);
+        return nullptr;
     }
-
-    if (isRequestingJob == 1)
+    if (!current_job_in_session(share.epoch))
     {
-        l_info(TAG_NETWORK, "Already requesting a job");
-        return 0;
+        l_error(TAG_NETWORK, "Share 0x%08x of a past session, dropped", share.nonce);
+        return nullptr;
     }
 
-    isRequestingJob = 1;
+    // Com version rolling o share leva os bits da versão como sexto parâmetro (BIP 310).
+    // O espaço do ID tem os dígitos do ID deste share, o payload é remontado quando ele ganha um dígito
+    SubmitTemplate &submit = submits[share.epoch % CURRENT_JOB_HISTORY];
+    if (!submit.isRenderedFor(share.epoch, peekId()) &&
+        !submit.render(share.epoch, peekId(), configuration.wallet_address.c_str(), job->job_id, job->extranonce2_size, share.ntime, job->version_mask != 0))
+    {
+        l_error(TAG_NETWORK, "Submit of job %s doesn't fit %d bytes, dropped", job->job_id, SUBMIT_PAYLOAD_SIZE);
+        return nullptr;
+    }
+    id = track(INFLIGHT_SUBMIT, share.epoch, share.nonce);
+    submit.patch(id, share.extranonce2, share.nonce, share.version_bits);
+    return submit.getPayload();
+}
 
-    // Se não conseguir conectar à rede, reseta a sessão e retorna erro
-    if (isConnected() == -1)
+/**
+ * @brief Envia uma submissão de share para o pool.
+ *
+ * Coloca o share no anel do miner, a rede envia no próximo passo (a tarefa de rede no ESP32, o próprio miner no ESP8266).
+ *
+ * @param core Índice do miner que encontrou o share.
+ * @param share O share em formato binário.
+ */
+void network_send(uint32_t core, const Share &share)
+{
+    if (!shares[core].push(share))
     {
-        current_resetSession();
-        return -1;
+        l_error(TAG_NETWORK, "[%d] Share queue is full, %d dropped", core, shares[core].getDropped());
     }
+    network_wake();
+}
 
-    // Se não houver uma sessão ativa, faz subscribe, authorize e define a dificuldade
-    if (current_getSessionId() == nullptr)
+/**
+ * @brief Escuta as mensagens da rede.
+ *
+ * Entrega ao parser tudo o que já chegou, cada mensagem completa é processada na hora.
+ * Uma mensagem pela metade fica no parser e continua na próxima chamada, nada aqui espera pelo pool.
+ */
+void network_listen()
+{
+    stratum.setNotification(&notifications[notification_next]);
+    uint8_t data[NETWORK_BUFFER_SIZE];
+    int available;
+    while ((available = client.available()) > 0)
     {
-        subscribe();
-        authorize();
-        difficulty();
+        const int len = client.read(data, available < NETWORK_BUFFER_SIZE ? available : NETWORK_BUFFER_SIZE);
+        if (len <= 0)
+        {
+            break;
+        }
+        stratum.feed(data, len, response);
     }
 
-    return 1;
+    // Nada mais chegou, fim da rajada: monta só o notify mais novo
+    applyNotification();
 }
 
 /**
- * @brief Enfileira um payload para envio posterior.
+ * @brief Envia todos os shares enfileirados pelos miners.
  *
- * Se a fila não estiver cheia, copia o payload para o array e incrementa o contador.
+ * Só com a sessão autorizada, até lá os shares esperam nos anéis.
+ */
+void network_submit_all()
+{
+    Share share;
+    uint64_t id;
+    for (uint32_t core = 0; core < CORE; core++)
+    {
+        while (shares[core].pop(share))
+        {
+            const char *payload = serializeShare(share, id);
+            if (payload != nullptr)
+            {
+                request(payload, id);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Muda o estado da conexão e marca o início dele, usado pelos timeouts.
+ */
+void network_enter(network_state_t state)
+{
+    network_state = state;
+    network_state_since = millis();
+}
+
+/**
+ * @brief Fecha o que estiver aberto e espera antes de tentar de novo, o tempo dobra a cada falha.
  *
- * @param payload A mensagem a ser enfileirada.
+ * O job atual não é descartado, os miners continuam nele até o pool voltar.
  */
-void enqueue(const char *payload)
+void network_fail(const char *reason)
 {
-    if (payloads_count < MAX_PAYLOADS)
+    network_backoff = network_backoff == 0 ? NETWORK_BACKOFF_MIN : network_backoff * 2;
+    if (network_backoff > NETWORK_BACKOFF_MAX)
     {
-        // Copia o payload para a posição atual da fila, garantindo o tamanho máximo
-        strncpy(payloads[payloads_count], payload, MAX_PAYLOAD_SIZE - 1);
-        payloads_count++;
-        l_debug(TAG_NETWORK, "Payload queued: %s", payload);
+        network_backoff = NETWORK_BACKOFF_MAX;
     }
-    else
+    l_error(TAG_NETWORK, "%s, retrying in %lu ms", reason, (unsigned long)network_backoff);
+
+    if (network_state >= NETWORK_SUBSCRIBING)
     {
-        l_error(TAG_NETWORK, "Payload queue is full");
+        current_resetSession();
     }
+    client.stop();
+    stratum.reset();
+    inflight.clear();                 // As respostas da conexão antiga não chegam mais
+    outbound_length = 0;              // Nem o que não foi enviado
+    notification_pending = false;
+    isAuthorized = 0;
+    network_enter(NETWORK_BACKOFF);
 }
 
 /**
- * @brief Envia uma submissão de share para o pool.
+ * @brief Resolve o host do pool em network_pool_ip.
  *
- * Constrói um payload JSON para enviar o share (resultado da mineração) e o envia.
- *
- * @param job_id ID do trabalho atual.
- * @param extranonce2 Valor extranonce2.
- * @param ntime Tempo no formato ntime.
- * @param nonce O nonce encontrado.
+ * No ESP8266 a rede roda entre os lotes do miner, então a consulta tem prazo curto. No ESP32 ela só
+ * bloqueia a tarefa da rede, e o hostByName do core não aceita prazo.
  */
-void network_send(const std::string &job_id, const std::string &extranonce2, const std::string &ntime, const uint32_t &nonce)
+bool network_resolve()
 {
-    char payload[MAX_PAYLOAD_SIZE];
-    // Monta o payload JSON para submissão de share
-    snprintf(payload, sizeof(payload), "{\"id\":%llu,\"method\":\"mining.submit\",\"params\":[\"%s\",\"%s\",\"%s\",\"%s\",\"%08x\"]}\n", 
-             nextId(), 
-             configuration.wallet_address.c_str(), 
-             job_id.c_str(), 
-             extranonce2.c_str(), 
-             ntime.c_str(), 
-             nonce);
 #if defined(ESP8266)
-    request(payload);       // Envia o payload
-    network_listen();       // Escuta a resposta imediatamente (modo ESP8266)
+    return WiFi.hostByName(configuration.pool_url.c_str(), network_pool_ip, NETWORK_DNS_TIMEOUT) == 1;
 #else
-    enqueue(payload);       // Para ESP32, enfileira o payload para envio posterior
+    return WiFi.hostByName(configuration.pool_url.c_str(), network_pool_ip) == 1;
 #endif
 }
 
 /**
- * @brief Escuta as mensagens da rede.
+ * @brief Abre o socket com o pool, sem esperar mais que NETWORK_CONNECT_TIMEOUT.
+ */
+bool network_connect()
+{
+#if defined(ESP8266)
+    // O connect do ESP8266 espera pelo timeout do cliente
+    client.setTimeout(NETWORK_CONNECT_TIMEOUT);
+    return client.connect(network_pool_ip, configuration.pool_port);
+#else
+    return client.connect(network_pool_ip, configuration.pool_port, NETWORK_CONNECT_TIMEOUT);
+#endif
+}
+
+/**
+ * @brief Avança a conexão com o pool um passo, sem esperar por nada.
  *
- * Lê dados do cliente até encontrar uma nova linha ('\n') e processa a resposta.
+ * WiFi → DNS → TCP → subscribe → authorize → mineração. Cada estado tem um timeout, uma falha
+ * volta ao começo depois do backoff.
  */
-void network_listen()
+void network_step()
 {
-    uint32_t start_time = millis();  // Marca o tempo de início
-    uint32_t len = 0;
+    const uint32_t elapsed = millis() - network_state_since;
 
-    // Se não estiver conectado, reseta a sessão
-    if (isConnected() == -1)
+    // Perdeu o WiFi ou o socket no meio do caminho
+    if (network_state >= NETWORK_DNS && network_state != NETWORK_BACKOFF && WiFi.status() != WL_CONNECTED)
     {
-        current_resetSession();
-        return; // Trata a falha na conexão
+        network_wifi_failures++;
+        network_fail("WiFi disconnected");
+        return;
+    }
+    if (network_state >= NETWORK_SUBSCRIBING && network_state != NETWORK_BACKOFF && !client.connected())
+    {
+        network_pool_failures++;
+        network_fail("Pool disconnected");
+        return;
     }
 
-    do
+    switch (network_state)
     {
-        // Se mais de 5 segundos se passaram, sai do loop
-        if (millis() - start_time > 5000)
+    case NETWORK_DISCONNECTED:
+        if (WiFi.status() == WL_CONNECTED)
         {
-            l_debug(TAG_NETWORK, "Timeout occurred. Exiting network_listen loop.");
-            return;
+            network_enter(NETWORK_DNS);
+            break;
         }
-
-        char data[NETWORK_BUFFER_SIZE];
-        // Lê dados do cliente até encontrar '\n' ou atingir o tamanho do buffer
-        len = client.readBytesUntil('\n', data, sizeof(data) - 1);
-        l_debug(TAG_NETWORK, "<<< len: %d", len);
-        data[len] = '\0';  // Termina a string
-        if (data[0] != '\0')
+        l_info(TAG_NETWORK, "Connecting to %s...", configuration.wifi_ssid.c_str());
+        WiFi.begin(configuration.wifi_ssid.c_str(), configuration.wifi_password.c_str());
+        network_enter(NETWORK_WIFI);
+        break;
+    case NETWORK_WIFI:
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            // Conexão WiFi estabelecida. Loga informações de rede.
+            l_info(TAG_NETWORK, "Connected to WiFi");
+            l_info(TAG_NETWORK, "IP address: %s", WiFi.localIP().toString().c_str());
+            l_info(TAG_NETWORK, "MAC address: %s", WiFi.macAddress().c_str());
+            network_wifi_failures = 0;
+            network_enter(NETWORK_DNS);
+        }
+        else if (elapsed > NETWORK_WIFI_TIMEOUT)
         {
-            // Processa a resposta recebida
-            response(data);
+            network_wifi_failures++;
+            network_fail("Unable to connect to WiFi");
+        }
+        break;
+    case NETWORK_DNS:
+        l_debug(TAG_NETWORK, "Resolving host %s...", configuration.pool_url.c_str());
+        if (network_resolve())
+        {
+            network_enter(NETWORK_TCP);
+        }
+        else
+        {
+            network_pool_failures++;
+            network_fail("Unable to resolve host");
+        }
+        break;
+    case NETWORK_TCP:
+        l_debug(TAG_NETWORK, "Connecting to host %s...", network_pool_ip.toString().c_str());
+        if (!network_connect())
+        {
+            network_pool_failures++;
+            network_fail("Unable to connect to host");
+            break;
         }
+        // As mensagens já saem agrupadas por passo, o Nagle só atrasaria
+        client.setNoDelay(true);
 
-    } while (len > 0);
+        // Sessão nova: negocia o version rolling e faz subscribe, o authorize espera a resposta
+        stratum.reset();
+        configure();
+        subscribe();
+        network_enter(NETWORK_SUBSCRIBING);
+        break;
+    case NETWORK_SUBSCRIBING:
+        if (current_getSessionId() != nullptr)
+        {
+            authorize();
+            difficulty();
+            network_enter(NETWORK_AUTHORIZING);
+        }
+        else if (elapsed > NETWORK_RESPONSE_TIMEOUT)
+        {
+            network_pool_failures++;
+            network_fail("Subscribe timed out");
+        }
+        break;
+    case NETWORK_AUTHORIZING:
+        if (isAuthorized == 1)
+        {
+            network_pool_failures = 0;
+            network_backoff = 0;
+            network_enter(NETWORK_MINING);
+        }
+        else if (elapsed > NETWORK_RESPONSE_TIMEOUT)
+        {
+            network_pool_failures++;
+            network_fail("Authorize timed out");
+        }
+        break;
+    case NETWORK_MINING:
+        break;
+    case NETWORK_BACKOFF:
+        if (elapsed >= network_backoff)
+        {
+            network_enter(NETWORK_DISCONNECTED);
+        }
+        break;
+    }
 }
 
 /**
- * @brief Envia um payload e, em seguida, o remove da fila.
+ * @brief Conecta ao pool no boot.
  *
- * Após enviar o payload, percorre a fila de payloads e remove aquele que foi enviado.
+ * Avança a conexão até o subscribe ser enviado, a mineração começa quando chegar o primeiro job.
  *
- * @param payload A mensagem a ser enviada.
+ * @return 1 se conectou, -1 se o WiFi ou o pool falharam mais vezes que o permitido.
  */
-void network_submit(const char *payload)
+short network_getJob()
 {
-    if (isConnected() == -1)
-    {
-        current_resetSession();
-        return; // Trata a falha na conexão
-    }
-
-    request(payload);
-
-    // Remove o payload enviado da fila (shift dos demais elementos)
-    for (size_t i = 0; i < payloads_count; ++i)
+    while (network_state < NETWORK_SUBSCRIBING || network_state == NETWORK_BACKOFF)
     {
-        if (strcmp(payloads[i], payload) == 0)
+        if (network_wifi_failures >= NETWORK_WIFI_ATTEMPTS || network_pool_failures >= NETWORK_STRATUM_ATTEMPTS)
         {
-            // Move os payloads seguintes para ocupar o lugar do removido
-            for (size_t j = i; j < payloads_count - 1; ++j)
-            {
-                strcpy(payloads[j], payloads[j + 1]);
-            }
-            payloads_count--;
-            break;
+            return -1;
         }
+        network_step();
+        network_flush();
+        delay(10);
     }
+    return 1;
 }
 
 /**
- * @brief Envia todos os payloads enfileirados.
+ * @brief Um passo da rede: avança a conexão, publica o próximo job, envia os shares e lê o pool.
+ *
+ * Não bloqueia, no ESP8266 é chamado pelo miner entre os lotes. O que o passo gerou sai em uma escrita só.
  */
-void network_submit_all()
+void network_loop()
 {
-    for (size_t i = 0; i < payloads_count; ++i)
+    network_step();
+
+    // Se algum miner esgotou o job, publica o próximo da fila
+    current_job_service();
+
+    const uint32_t expired = inflight.expire(millis(), NETWORK_RESPONSE_TIMEOUT);
+    if (expired > 0)
+    {
+        l_error(TAG_NETWORK, "%lu requests without response", (unsigned long)expired);
+    }
+
+    if (network_state == NETWORK_MINING)
     {
-        network_submit(payloads[i]);
+        network_submit_all();
+    }
+    if (network_state >= NETWORK_SUBSCRIBING && network_state <= NETWORK_MINING && client.available() > 0)
+    {
+        network_listen();
+    }
+
+    // Tudo o que o passo produziu sai em uma escrita
+    if (network_state >= NETWORK_SUBSCRIBING && network_state <= NETWORK_MINING)
+    {
+        network_flush();
     }
 }
 
 #if defined(ESP32)
-// Define um timeout para a tarefa de rede
-#define NETWORK_TASK_TIMEOUT 100
+// Sem notificação, a tarefa acorda nesse intervalo para ver se chegou algo do pool
+#define NETWORK_TASK_TIMEOUT 20
+TaskHandle_t network_task = nullptr;
+
+void network_wake()
+{
+    if (network_task != nullptr)
+    {
+        xTaskNotifyGive(network_task);
+    }
+}
+
 /**
  * @brief Função de tarefa para gerenciamento de rede no ESP32.
  *
- * Em loop, envia todos os payloads enfileirados e escuta as respostas, com um delay fixo entre as iterações.
+ * Dorme até um miner enfileirar um share ou esgotar o job. O WiFiClient não avisa quando há dados para ler,
+ * então a cada NETWORK_TASK_TIMEOUT avança a conexão e confere available().
  *
  * @param pvParameters Parâmetros da tarefa (não utilizado aqui).
  */
 void networkTaskFunction(void *pvParameters)
 {
+    network_task = xTaskGetCurrentTaskHandle();
     while (1)
     {
-        network_submit_all();  // Tenta enviar todos os payloads pendentes
-        network_listen();      // Escuta as respostas do pool
-        // Delay para evitar saturar a CPU, convertido para ticks do FreeRTOS
-        vTaskDelay(NETWORK_TASK_TIMEOUT / portTICK_PERIOD_MS);
+        ulTaskNotifyTake(pdTRUE, NETWORK_TASK_TIMEOUT / portTICK_PERIOD_MS);
+        network_loop();        // Envia os shares, publica o próximo job e escuta o pool
     }
 }
+#else
+void network_wake()
+{
+}
 #endif
@@ -1,9 +1,11 @@
 #ifndef NETWORK_H
 #define NETWORK_H
-#include <cJSON.h>
 #include <string>
+#include "model/share.h"
 short network_getJob();
-void network_send(const std::string &job_id, const std::string &extranonce2, const std::string &ntime, const uint32_t &nonce);
+void network_send(uint32_t core, const Share &share);
 void network_listen();
+void network_loop();
+void network_wake();
 void networkTaskFunction(void *pvParameters);
 #endif // NETWORK_H
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "network/sharering.h"
+
+bool ShareRing::push(const Share &share)
+{
+#if defined(ESP8266)
+    const uint32_t position = head;
+    if (position - tail == SHARE_RING_SIZE)
+    {
+        dropped++;
+        return false;
+    }
+    shares[position & (SHARE_RING_SIZE - 1)] = share;
+    head = position + 1;
+#else
+    const uint32_t position = head.load(std::memory_order_relaxed);
+    if (position - tail.load(std::memory_order_acquire) == SHARE_RING_SIZE)
+    {
+        dropped++;
+        return false;
+    }
+    shares[position & (SHARE_RING_SIZE - 1)] = share;
+    // Publishes the record before the new head
+    head.store(position + 1, std::memory_order_release);
+#endif
+    return true;
+}
+
+bool ShareRing::pop(Share &share)
+{
+#if defined(ESP8266)
+    const uint32_t position = tail;
+    if (position == head)
+    {
+        return false;
+    }
+    share = shares[position & (SHARE_RING_SIZE - 1)];
+    tail = position + 1;
+#else
+    const uint32_t position = tail.load(std::memory_order_relaxed);
+    if (position == head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    share = shares[position & (SHARE_RING_SIZE - 1)];
+    // Frees the slot only after it was copied
+    tail.store(position + 1, std::memory_order_release);
+#endif
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef SHARERING_H
+#define SHARERING_H
+
+#include <stdint.h>
+#if !defined(ESP8266)
+#include <atomic>
+#endif
+#include "model/share.h"
+
+#define SHARE_RING_SIZE 8 // Power of two
+
+/**
+ * Single producer / single consumer ring of shares: one miner pushes, the network task pops.
+ * Head and tail are only ever written by their own side, so no lock is needed.
+ */
+class ShareRing
+{
+public:
+    /**
+     * Producer side.
+     *
+     * @return false if the ring is full, the share is dropped.
+     */
+    bool push(const Share &share);
+
+    /**
+     * Consumer side.
+     *
+     * @return false if there is nothing to send.
+     */
+    bool pop(Share &share);
+
+    uint32_t getDropped() const { return dropped; }
+
+private:
+    Share shares[SHARE_RING_SIZE];
+#if defined(ESP8266)
+    // Single core, miner and network never run at the same time
+    uint32_t head = 0;
+    uint32_t tail = 0;
+#else
+    std::atomic<uint32_t> head{0}; // Next slot to write, owned by the miner
+    std::atomic<uint32_t> tail{0}; // Next slot to read, owned by the network task
+#endif
+    uint32_t dropped = 0;
+};
+
+#endif // SHARERING_H
@@ -0,0 +1,593 @@
+#include <Arduino.h>
+#include "network/stratum.h"
+#include <stdlib.h>
+#include <string.h>
+#include "utils/log.h"
+
+#define TAG_STRATUM "Stratum"
+
+static int8_t nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+void StratumParser::reset()
+{
+    depth = 0;
+    expect = EXPECT_VALUE;
+    allow_close = false;
+    skipping = false;
+    token = TOKEN_NONE;
+    escape = false;
+    unicode = 0;
+}
+
+uint32_t StratumParser::feed(const uint8_t *data, size_t length, Handler handler)
+{
+    uint32_t handled = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        const char c = (char)data[i];
+        if (skipping)
+        {
+            skipping = c != '\n';
+            continue;
+        }
+        if (!step(c, handler, handled) && c == '\n')
+        {
+            // The newline that broke the message also ends it
+            skipping = false;
+        }
+    }
+    return handled;
+}
+
+bool StratumParser::step(char c, Handler handler, uint32_t &handled)
+{
+    if (token == TOKEN_STRING)
+    {
+        if (unicode > 0)
+        {
+            // \uXXXX never shows up in the fields used, keep a placeholder
+            if (--unicode == 0)
+            {
+                stringChar('?');
+            }
+            return true;
+        }
+        if (escape)
+        {
+            escape = false;
+            switch (c)
+            {
+            case 'u':
+                unicode = 4;
+                return true;
+            case 'n':
+                stringChar('\n');
+                return true;
+            case 't':
+                stringChar('\t');
+                return true;
+            case 'r':
+                stringChar('\r');
+                return true;
+            case 'b':
+            case 'f':
+                return true;
+            default:
+                stringChar(c);
+                return true;
+            }
+        }
+        if (c == '\\')
+        {
+            escape = true;
+            return true;
+        }
+        if (c == '"')
+        {
+            return endString();
+        }
+        if (c == '\n')
+        {
+            fail("Unterminated string");
+            return false;
+        }
+        stringChar(c);
+        return true;
+    }
+
+    if (token != TOKEN_NONE)
+    {
+        const bool number_char = (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        if ((token == TOKEN_NUMBER && number_char) || (token == TOKEN_LITERAL && c >= 'a' && c <= 'z'))
+        {
+            if (scratch_length == STRATUM_KEY_SIZE - 1)
+            {
+                fail("Token too long");
+                return false;
+            }
+            scratch[scratch_length++] = c;
+            return true;
+        }
+        // c ends the token and is handled below
+        if (!endToken())
+        {
+            return false;
+        }
+    }
+
+    if (c == ' ' || c == '\t' || c == '\r')
+    {
+        return true;
+    }
+    if (c == '\n')
+    {
+        if (depth == 0)
+        {
+            return true;
+        }
+        fail("Truncated message");
+        return false;
+    }
+
+    if (depth == 0)
+    {
+        if (c != '{')
+        {
+            fail("Message is not an object");
+            return false;
+        }
+        beginMessage();
+        pushContainer(false);
+        return true;
+    }
+
+    const bool array = levels[depth - 1].array;
+    switch (expect)
+    {
+    case EXPECT_KEY:
+        if (c == '"')
+        {
+            token = TOKEN_STRING;
+            token_is_key = true;
+            scratch_length = 0;
+            sink = {scratch, STRATUM_KEY_SIZE, 0, nullptr, 0, 0, false, false};
+            hex_field = HEX_NONE;
+            allow_close = false;
+            return true;
+        }
+        if (c == '}' && allow_close)
+        {
+            return close(handler, handled);
+        }
+        break;
+    case EXPECT_COLON:
+        if (c == ':')
+        {
+            expect = EXPECT_VALUE;
+            return true;
+        }
+        break;
+    case EXPECT_VALUE:
+        if (c == ']' && array && allow_close)
+        {
+            return close(handler, handled);
+        }
+        return beginValue(c);
+    case EXPECT_SEPARATOR:
+        if (c == ',')
+        {
+            if (array)
+            {
+                levels[depth - 1].index++;
+            }
+            expect = array ? EXPECT_VALUE : EXPECT_KEY;
+            allow_close = false;
+            return true;
+        }
+        if (c == (array ? ']' : '}'))
+        {
+            return close(handler, handled);
+        }
+        break;
+    }
+
+    fail("Unexpected character");
+    return false;
+}
+
+bool StratumParser::beginValue(char c)
+{
+    allow_close = false;
+    if (c == '"')
+    {
+        beginString();
+        return true;
+    }
+    if (c == '{' || c == '[')
+    {
+        if (depth == STRATUM_DEPTH)
+        {
+            fail("Message too deep");
+            return false;
+        }
+        value(c == '[' ? STRATUM_ARRAY : STRATUM_OBJECT, 0, false);
+        pushContainer(c == '[');
+        return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        token = TOKEN_NUMBER;
+    }
+    else if (c == 't' || c == 'f' || c == 'n')
+    {
+        token = TOKEN_LITERAL;
+    }
+    else
+    {
+        fail("Unexpected character");
+        return false;
+    }
+    scratch[0] = c;
+    scratch_length = 1;
+    return true;
+}
+
+bool StratumParser::endToken()
+{
+    scratch[scratch_length] = '\0';
+    const Token ended = token;
+    token = TOKEN_NONE;
+    if (ended == TOKEN_NUMBER)
+    {
+        char *end;
+        const double number = strtod(scratch, &end);
+        if (end != scratch + scratch_length)
+        {
+            fail("Invalid number");
+            return false;
+        }
+        value(STRATUM_NUMBER, number, false);
+    }
+    else if (strcmp(scratch, "true") == 0 || strcmp(scratch, "false") == 0)
+    {
+        value(STRATUM_BOOL, 0, scratch[0] == 't');
+    }
+    else if (strcmp(scratch, "null") == 0)
+    {
+        value(STRATUM_NULL, 0, false);
+    }
+    else
+    {
+        fail("Invalid literal");
+        return false;
+    }
+    expect = EXPECT_SEPARATOR;
+    return true;
+}
+
+void StratumParser::beginString()
+{
+    token = TOKEN_STRING;
+    token_is_key = false;
+    sink = {nullptr, 0, 0, nullptr, 0, 0, true, false, false};
+    hex_field = HEX_NONE;
+
+    const Level &parent = levels[depth - 1];
+    if (depth == 1)
+    {
+        if (parent.key == KEY_METHOD)
+        {
+            sink.text = message.method;
+            sink.text_size = STRATUM_METHOD_SIZE;
+        }
+        return;
+    }
+
+    if (inTop(KEY_PARAMS) && depth == 2 && parent.array && parent.index < STRATUM_PARAMS)
+    {
+        sink.text = message.param_text[parent.index];
+        sink.text_size = STRATUM_TEXT_SIZE;
+        if (notification == nullptr)
+        {
+            return;
+        }
+        // mining.notify: prevhash, coinb1 and coinb2 are decoded while they are received
+        switch (parent.index)
+        {
+        case 1:
+            hex_field = HEX_PREVHASH;
+            sink.hex = notification->prevhash;
+            sink.hex_size = NOTIFICATION_HASH_SIZE;
+            break;
+        case 2:
+            hex_field = HEX_COINB1;
+            sink.hex = notification->coinb1;
+            sink.hex_size = NOTIFICATION_COINB1_SIZE;
+            break;
+        case 3:
+            hex_field = HEX_COINB2;
+            sink.hex = notification->coinb2;
+            sink.hex_size = NOTIFICATION_COINB2_SIZE;
+            break;
+        }
+        return;
+    }
+
+    if (inTop(KEY_PARAMS) && depth == 3 && at(1, 4) && parent.array && notification != nullptr)
+    {
+        if (notification->merkle_branch_count == NOTIFICATION_MERKLE_BRANCHES)
+        {
+            message.notification_valid = false;
+            return;
+        }
+        hex_field = HEX_MERKLE_BRANCH;
+        sink.hex = notification->merkle_branch[notification->merkle_branch_count];
+        sink.hex_size = NOTIFICATION_HASH_SIZE;
+        return;
+    }
+
+    if (!inTop(KEY_RESULT))
+    {
+        return;
+    }
+    if (depth == 2 && at(1, 1))
+    {
+        sink.text = message.extranonce1;
+    }
+    else if (depth == 2 && !parent.array && parent.key == KEY_VERSION_ROLLING_MASK)
+    {
+        sink.text = message.version_mask;
+    }
+    else if ((depth == 4 && at(1, 0) && at(2, 0) && at(3, 1)) || (depth == 3 && at(1, 0) && at(2, 1)))
+    {
+        // [[["mining.notify", id], ...], ...] or the flat [["mining.notify", id], ...]
+        sink.text = message.subscription_id;
+    }
+    sink.text_size = STRATUM_TEXT_SIZE;
+}
+
+void StratumParser::stringChar(char c)
+{
+    if (sink.text != nullptr)
+    {
+        if (sink.text_length < sink.text_size - 1)
+        {
+            sink.text[sink.text_length++] = c;
+        }
+        else
+        {
+            sink.truncated = true;
+        }
+    }
+    if (sink.hex != nullptr && sink.hex_valid)
+    {
+        const int8_t n = nibble(c);
+        if (n < 0)
+        {
+            sink.hex_valid = false;
+            return;
+        }
+        if (sink.hex_overflow || sink.nibbles / 2 == sink.hex_size)
+        {
+            // Keeps counting so the size can be reported
+            sink.hex_overflow = true;
+            sink.nibbles++;
+            return;
+        }
+        uint8_t &byte = sink.hex[sink.nibbles / 2];
+        byte = (sink.nibbles % 2 == 0) ? (n << 4) : (byte | n);
+        sink.nibbles++;
+    }
+}
+
+bool StratumParser::endString()
+{
+    token = TOKEN_NONE;
+    if (sink.text != nullptr)
+    {
+        sink.text[sink.text_length] = '\0';
+    }
+
+    if (token_is_key)
+    {
+        levels[depth - 1].key = sink.truncated ? KEY_OTHER : keyOf(scratch);
+        expect = EXPECT_COLON;
+        return true;
+    }
+
+    if (hex_field != HEX_NONE)
+    {
+        const size_t size = sink.nibbles / 2;
+        bool valid = sink.hex_valid && !sink.hex_overflow && sink.nibbles % 2 == 0;
+        switch (hex_field)
+        {
+        case HEX_PREVHASH:
+            valid = valid && size == NOTIFICATION_HASH_SIZE;
+            break;
+        case HEX_COINB1:
+        case HEX_COINB2:
+            if (sink.hex_valid && sink.hex_overflow)
+            {
+                l_error(TAG_STRATUM, "coinb%d has %u bytes, only %u fit", hex_field == HEX_COINB1 ? 1 : 2, (unsigned)size, (unsigned)sink.hex_size);
+                message.coinbase_oversized = true;
+            }
+            if (hex_field == HEX_COINB1)
+            {
+                notification->coinb1_size = valid ? size : 0;
+            }
+            else
+            {
+                notification->coinb2_size = valid ? size : 0;
+            }
+            break;
+        case HEX_MERKLE_BRANCH:
+            valid = valid && size == NOTIFICATION_HASH_SIZE;
+            notification->merkle_branch_count += valid ? 1 : 0;
+            break;
+        default:
+            break;
+        }
+        message.notification_valid = message.notification_valid && valid;
+    }
+
+    value(sink.truncated ? STRATUM_TRUNCATED : STRATUM_STRING, 0, false);
+    expect = EXPECT_SEPARATOR;
+    return true;
+}
+
+void StratumParser::beginMessage()
+{
+    memset(&message, 0, sizeof(message));
+    if (notification != nullptr)
+    {
+        notification->coinb1_size = 0;
+        notification->coinb2_size = 0;
+        notification->merkle_branch_count = 0;
+        message.notification_valid = true;
+    }
+}
+
+void StratumParser::pushContainer(bool array)
+{
+    levels[depth] = {array, KEY_OTHER, 0};
+    depth++;
+    expect = array ? EXPECT_VALUE : EXPECT_KEY;
+    allow_close = true;
+}
+
+bool StratumParser::close(Handler handler, uint32_t &handled)
+{
+    depth--;
+    allow_close = false;
+    if (depth > 0)
+    {
+        expect = EXPECT_SEPARATOR;
+        return true;
+    }
+    expect = EXPECT_VALUE;
+    handler(message);
+    handled++;
+    return true;
+}
+
+/**
+ * Stores a scalar, or notes the type of a container, found at the current path.
+ */
+void StratumParser::value(StratumType type, double number, bool boolean)
+{
+    const Level &parent = levels[depth - 1];
+    if (depth == 1)
+    {
+        switch (parent.key)
+        {
+        case KEY_ID:
+            message.has_id = type == STRATUM_NUMBER;
+            message.id = type == STRATUM_NUMBER ? (uint64_t)number : 0;
+            break;
+        case KEY_RESULT:
+            message.result = type;
+            message.result_true = type == STRATUM_BOOL && boolean;
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+
+    if (inTop(KEY_PARAMS) && depth == 2 && parent.array)
+    {
+        if (parent.index < STRATUM_PARAMS)
+        {
+            message.param_type[parent.index] = type;
+            message.param_number[parent.index] = number;
+            message.param_bool[parent.index] = boolean;
+        }
+        message.param_count = parent.index + 1;
+        return;
+    }
+
+    if (inTop(KEY_RESULT))
+    {
+        if (depth == 2 && at(1, 2) && type == STRATUM_NUMBER)
+        {
+            message.extranonce2_size = (int)number;
+        }
+        else if (depth == 2 && !parent.array && parent.key == KEY_VERSION_ROLLING)
+        {
+            message.version_rolling = type == STRATUM_BOOL && boolean;
+        }
+        else if (depth == 3 && at(1, 0) && at(2, 0) && type == STRATUM_ARRAY)
+        {
+            message.is_subscribe = true;
+        }
+        return;
+    }
+
+    if (inTop(KEY_ERROR) && depth == 2 && type == STRATUM_NUMBER && (at(1, 0) || (!parent.array && parent.key == KEY_CODE)))
+    {
+        message.error_code = (int)number;
+    }
+}
+
+void StratumParser::fail(const char *reason)
+{
+    l_error(TAG_STRATUM, "%s, skipping line", reason);
+    depth = 0;
+    token = TOKEN_NONE;
+    escape = false;
+    unicode = 0;
+    expect = EXPECT_VALUE;
+    skipping = true;
+}
+
+StratumParser::Key StratumParser::keyOf(const char *key) const
+{
+    if (strcmp(key, "id") == 0)
+    {
+        return KEY_ID;
+    }
+    if (strcmp(key, "method") == 0)
+    {
+        return KEY_METHOD;
+    }
+    if (strcmp(key, "params") == 0)
+    {
+        return KEY_PARAMS;
+    }
+    if (strcmp(key, "result") == 0)
+    {
+        return KEY_RESULT;
+    }
+    if (strcmp(key, "error") == 0)
+    {
+        return KEY_ERROR;
+    }
+    if (strcmp(key, "code") == 0)
+    {
+        return KEY_CODE;
+    }
+    if (strcmp(key, "version-rolling") == 0)
+    {
+        return KEY_VERSION_ROLLING;
+    }
+    if (strcmp(key, "version-rolling.mask") == 0)
+    {
+        return KEY_VERSION_ROLLING_MASK;
+    }
+    return KEY_OTHER;
+}
@@ -0,0 +1,182 @@
+#ifndef STRATUM_H
+#define STRATUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "model/notification.h"
+
+#define STRATUM_DEPTH 6        // Deepest nesting used by Stratum is the subscribe result
+#define STRATUM_PARAMS 9       // mining.notify has the most params
+#define STRATUM_TEXT_SIZE 72   // Short strings kept as text: job id, extranonce1, scalars, masks
+#define STRATUM_KEY_SIZE 24
+#define STRATUM_METHOD_SIZE 32
+
+enum StratumType : uint8_t
+{
+    STRATUM_NONE = 0,
+    STRATUM_NULL,
+    STRATUM_BOOL,
+    STRATUM_NUMBER,
+    STRATUM_STRING,
+    STRATUM_TRUNCATED, // String longer than STRATUM_TEXT_SIZE - 1
+    STRATUM_ARRAY,
+    STRATUM_OBJECT,
+};
+
+/**
+ * One Stratum message as decoded by StratumParser. Only the shapes the miner uses are kept,
+ * the hex fields of a mining.notify go straight into the parser's Notification.
+ */
+struct StratumMessage
+{
+    bool has_id;
+    uint64_t id;
+    char method[STRATUM_METHOD_SIZE];
+
+    // Responses
+    StratumType result;
+    bool result_true;
+    bool is_subscribe; // [[subscriptions], extranonce1, extranonce2_size]
+    char subscription_id[STRATUM_TEXT_SIZE];
+    char extranonce1[STRATUM_TEXT_SIZE];
+    int extranonce2_size;
+    bool version_rolling; // mining.configure
+    char version_mask[STRATUM_TEXT_SIZE];
+    int error_code; // 0 without error
+
+    // Notifications
+    uint8_t param_count;
+    StratumType param_type[STRATUM_PARAMS];
+    char param_text[STRATUM_PARAMS][STRATUM_TEXT_SIZE];
+    double param_number[STRATUM_PARAMS];
+    bool param_bool[STRATUM_PARAMS];
+    bool notification_valid; // Hex fields decoded without error, scalars are left to the caller
+    bool coinbase_oversized; // coinb1 or coinb2 longer than its Notification buffer
+};
+
+/**
+ * Streaming tokenizer for line delimited Stratum JSON. Bytes are consumed as they are received,
+ * a message can span any number of reads and there is no line buffer, so long lines are never truncated.
+ * Nothing is allocated, values are written straight into StratumMessage and the Notification.
+ */
+class StratumParser
+{
+public:
+    typedef void (*Handler)(StratumMessage &message);
+
+    /**
+     * Where the hex fields of the next mining.notify are decoded, may be null.
+     */
+    void setNotification(Notification *notification) { this->notification = notification; }
+
+    /**
+     * Consumes received bytes, calling handler for every complete message.
+     *
+     * @return the number of messages handled.
+     */
+    uint32_t feed(const uint8_t *data, size_t length, Handler handler);
+
+    /**
+     * @return true between messages, false while one is partially received.
+     */
+    bool isIdle() const { return depth == 0 && !skipping; }
+
+    void reset();
+
+private:
+    enum Expect : uint8_t
+    {
+        EXPECT_KEY,
+        EXPECT_COLON,
+        EXPECT_VALUE,
+        EXPECT_SEPARATOR,
+    };
+
+    enum Token : uint8_t
+    {
+        TOKEN_NONE,
+        TOKEN_STRING,
+        TOKEN_NUMBER,
+        TOKEN_LITERAL,
+    };
+
+    enum Key : uint8_t
+    {
+        KEY_OTHER,
+        KEY_ID,
+        KEY_METHOD,
+        KEY_PARAMS,
+        KEY_RESULT,
+        KEY_ERROR,
+        KEY_CODE,
+        KEY_VERSION_ROLLING,
+        KEY_VERSION_ROLLING_MASK,
+    };
+
+    struct Level
+    {
+        bool array;
+        Key key;        // Objects: key of the current value
+        uint16_t index; // Arrays: index of the current value
+    };
+
+    // Where the characters of the current string go
+    struct Sink
+    {
+        char *text;
+        size_t text_size;
+        size_t text_length;
+        uint8_t *hex;
+        size_t hex_size;
+        size_t nibbles;
+        bool hex_valid;
+        bool hex_overflow; // Still counted, nothing written past hex_size
+        bool truncated;
+    };
+
+    // Notification field the current hex string is decoded into
+    enum HexField : uint8_t
+    {
+        HEX_NONE,
+        HEX_PREVHASH,
+        HEX_COINB1,
+        HEX_COINB2,
+        HEX_MERKLE_BRANCH,
+    };
+
+    bool step(char c, Handler handler, uint32_t &handled);
+    bool beginValue(char c);
+    bool endToken();
+    bool endString();
+    void beginString();
+    bool close(Handler handler, uint32_t &handled);
+    void beginMessage();
+    void pushContainer(bool array);
+    void value(StratumType type, double number, bool boolean);
+    void stringChar(char c);
+    void fail(const char *reason);
+    Key keyOf(const char *key) const;
+
+    // Path of the value being parsed
+    bool inTop(Key key) const { return depth >= 2 && levels[0].key == key; }
+    bool at(uint8_t level, uint16_t index) const { return levels[level].array && levels[level].index == index; }
+
+    Notification *notification = nullptr;
+    StratumMessage message;
+    Level levels[STRATUM_DEPTH];
+    uint8_t depth = 0;
+    Expect expect = EXPECT_VALUE;
+    bool allow_close = false; // Right after '{' or '['
+    bool skipping = false;    // Malformed line, ignored up to the newline
+
+    Token token = TOKEN_NONE;
+    bool token_is_key = false;
+    bool escape = false;
+    uint8_t unicode = 0; // \uXXXX digits left to skip
+    char scratch[STRATUM_KEY_SIZE]; // Keys, numbers and literals
+    uint8_t scratch_length = 0;
+    Sink sink;
+    HexField hex_field = HEX_NONE;
+};
+
+#endif // STRATUM_H
@@ -0,0 +1,66 @@
+#include "network/submit.h"
+#include <stdio.h>
+
+static void writeHex(char *output, uint64_t value, uint8_t digits, const char *alphabet)
+{
+    for (int i = digits - 1; i >= 0; i--)
+    {
+        output[i] = alphabet[value & 0xf];
+        value >>= 4;
+    }
+}
+
+uint8_t SubmitTemplate::digits(uint64_t id)
+{
+    uint8_t count = 1;
+    while (id >= 10)
+    {
+        id /= 10;
+        count++;
+    }
+    return count;
+}
+
+bool SubmitTemplate::render(uint32_t epoch, uint64_t id, const char *wallet, const char *job_id, int extranonce2_size, uint32_t ntime, bool version_rolling)
+{
+    length = 0;
+    this->epoch = epoch;
+    id_digits = digits(id);
+    extranonce2_digits = extranonce2_size * 2;
+
+    // The holes are filled with zeros here, patch() overwrites them in place
+    int written = snprintf(payload, SUBMIT_PAYLOAD_SIZE, "{\"id\":%0*d,\"method\":\"mining.submit\",\"params\":[\"%s\",\"%s\",\"%0*d\",\"%08x\",\"00000000\"%s]}\n",
+                           id_digits, 0, wallet, job_id, extranonce2_digits, 0, ntime,
+                           version_rolling ? ",\"00000000\"" : "");
+    if (written <= 0 || written >= SUBMIT_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+
+    // Offsets counted from the end, past the wallet and job id: "nonce"]}\n or "nonce","version"]}\n
+    id_offset = 6;
+    nonce_offset = written - (version_rolling ? 15 : 4) - 8;
+    version_offset = version_rolling ? written - 4 - 8 : 0;
+    extranonce2_offset = nonce_offset - 14 - extranonce2_digits; // ","ntime","
+    length = written;
+    return true;
+}
+
+size_t SubmitTemplate::patch(uint64_t id, uint64_t extranonce2, uint32_t nonce, uint32_t version_bits)
+{
+    // Decimal id, the hole has exactly its digits
+    for (int i = id_digits - 1; i >= 0; i--)
+    {
+        payload[id_offset + i] = '0' + id % 10;
+        id /= 10;
+    }
+
+    // Same cases as before: extranonce2 upper case like Job::formatExtranonce2, the rest lower case
+    writeHex(payload + extranonce2_offset, extranonce2, extranonce2_digits, "0123456789ABCDEF");
+    writeHex(payload + nonce_offset, nonce, 8, "0123456789abcdef");
+    if (version_offset != 0)
+    {
+        writeHex(payload + version_offset, version_bits, 8, "0123456789abcdef");
+    }
+    return length;
+}
@@ -0,0 +1,49 @@
+#ifndef SUBMIT_H
+#define SUBMIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SUBMIT_PAYLOAD_SIZE 256
+
+/**
+ * mining.submit of one job rendered once, with fixed width holes for what changes between its shares:
+ * the request id, extranonce2, nonce and the version bits when rolling.
+ * The id hole has the digits of the id it was rendered for, ids only grow so it is
+ * rendered again only when they gain a digit.
+ */
+class SubmitTemplate
+{
+public:
+    /**
+     * Renders the payload for a job, with an id hole as wide as id.
+     *
+     * @return false if it doesn't fit SUBMIT_PAYLOAD_SIZE.
+     */
+    bool render(uint32_t epoch, uint64_t id, const char *wallet, const char *job_id, int extranonce2_size, uint32_t ntime, bool version_rolling);
+
+    /**
+     * Writes a share into the holes, id must have the digits the payload was rendered for.
+     *
+     * @return the payload length.
+     */
+    size_t patch(uint64_t id, uint64_t extranonce2, uint32_t nonce, uint32_t version_bits);
+
+    bool isRenderedFor(uint32_t epoch, uint64_t id) const { return length > 0 && this->epoch == epoch && digits(id) == id_digits; }
+    const char *getPayload() const { return payload; }
+
+private:
+    static uint8_t digits(uint64_t id);
+
+    char payload[SUBMIT_PAYLOAD_SIZE];
+    size_t length = 0;
+    uint32_t epoch = 0;
+    uint16_t id_offset = 0;
+    uint8_t id_digits = 0;
+    uint16_t extranonce2_offset = 0;
+    uint8_t extranonce2_digits = 0;
+    uint16_t nonce_offset = 0;
+    uint16_t version_offset = 0; // 0 without version rolling
+};
+
+#endif // SUBMIT_H
@@ -3,6 +3,7 @@
 #include "utils/log.h"
 #include "model/configuration.h"
 #include "current.h"
+#include "miner/engine.h"
 #include "leafminer.h"
 #include "lilygo-t-s3-include.h"
 #include "geekmagicclock-smalltv-include.h"
@@ -59,9 +60,8 @@ void screen_loop()
   tft.pushImage(0, 0, WIDTH, HEIGHT, home);
 
   // version
-  char leafMiner[20];
-  strcpy(leafMiner, "LeafMiner v.");
-  strcat(leafMiner, _VERSION);
+  char leafMiner[40];
+  snprintf(leafMiner, sizeof(leafMiner), "LeafMiner v.%s (%s)", _VERSION, engine_get()->name);
   tft.drawCentreString(leafMiner, TEXT_VERSION_X, TEXT_VERSION_Y, 1);
 
   // uptime
@@ -24,6 +24,8 @@ void storage_save(const Configuration &conf)
     preferences.putUInt("blink_bright", conf.blink_brightness);
     preferences.putString("lcd_on_start", conf.lcd_on_start.c_str());
     preferences.putString("auto_update", conf.auto_update.c_str());
+    preferences.putUInt("batch_size", conf.batch_size);
+    preferences.putUInt("yield_ms", conf.yield_ms);
     preferences.end();
 }
 
@@ -39,4 +41,6 @@ void storage_load(Configuration *conf)
     conf->blink_brightness = preferences.getUInt("blink_bright", 256);
     conf->lcd_on_start = preferences.getString("lcd_on_start", "on").c_str();
     conf->auto_update = "off";//preferences.getString("auto_update", "on").c_str();
+    conf->batch_size = preferences.getUInt("batch_size", 0);
+    conf->yield_ms = preferences.getUInt("yield_ms", 0);
 }
@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <stdio.h>
+#include <string.h>
 #include <string>
 
 // Constants for clarity
@@ -144,19 +145,14 @@ static int littleEndianCompare(const unsigned char *a, const unsigned char *b, s
  */
 static double littleEndian256ToDouble(const uint8_t *target)
 {
-    const uint64_t *data64;
-
-    data64 = reinterpret_cast<const uint64_t *>(target + 24);
-    double dcut64 = *data64 * BITS192;
-
-    data64 = reinterpret_cast<const uint64_t *>(target + 16);
-    dcut64 += *data64 * BITS128;
-
-    data64 = reinterpret_cast<const uint64_t *>(target + 8);
-    dcut64 += *data64 * BITS64;
-
-    data64 = reinterpret_cast<const uint64_t *>(target);
-    dcut64 += *data64;
+    // The hash buffers aren't 8 byte aligned, memcpy avoids unaligned 64-bit loads
+    uint64_t data64[4];
+    memcpy(data64, target, sizeof(data64));
+
+    double dcut64 = data64[3] * BITS192;
+    dcut64 += data64[2] * BITS128;
+    dcut64 += data64[1] * BITS64;
+    dcut64 += data64[0];
 
     return dcut64;
 }
@@ -11,7 +11,11 @@
 #include "utils/utils.h"
 #include "miner/sha256m.h"
 #include "miner/nerdSHA256plus.h"
+#include "miner/engine.h"
+#include "miner/tuner.h"
 #include "network/network.h"
+#include "network/stratum.h"
+#include "current.h"
 
 void test_create_target(void)
 {
@@ -26,6 +30,22 @@ void test_create_target(void)
     TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_target, target.value, sizeof(target.value));
 }
 
+void test_create_share_target(void)
+{
+    Target target;
+    target.fromDifficulty(1.0);
+
+    const char *expected_target_string = "00000000ffff0000000000000000000000000000000000000000000000000000";
+    uint8_t expected_target[32];
+    stringToLittleEndianBytes(expected_target_string, expected_target);
+
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_target, target.value, sizeof(target.value));
+
+    // The target must map back to the same difficulty
+    target.fromDifficulty(0.0032);
+    TEST_ASSERT_FLOAT_WITHIN(0.0000001, 0.0032, diff_from_target(target.value));
+}
+
 void test_create_block_and_mine(void)
 {
     const char *nbits = "19015f53";
@@ -72,17 +92,31 @@ void test_create_block_and_mine(void)
     TEST_ASSERT_TRUE(littleEndianCompare(hash, target.value, 32) < 0);
 }
 
+// Notify and subscribe of the stratum example below, shared by the job tests
+static const char *TEST_PREVHASH = "7dcf1304b04e79024066cd9481aa464e2fe17966e19edf6f33970e1fe0b60277";
+static const char *TEST_COINB1 = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff270362f401062f503253482f049b8f175308";
+static const char *TEST_COINB2 = "0d2f7374726174756d506f6f6c2f000000000100868591052100001976a91431482118f1d7504daf1c001cbfaf91ad580d176d88ac00000000";
+
+static void makeNotification(Notification &notification, const char *job_id, bool clean_jobs = true)
+{
+    TEST_ASSERT_TRUE(notification.parse(job_id, TEST_PREVHASH, TEST_COINB1, TEST_COINB2, "20000000", "1b44dfdb", "53178f9b", clean_jobs));
+}
+
+static Subscribe *makeSubscribe(const char *session_id = "ae6812eb4cd7735a302a8a9dd95cf71f", const char *extranonce1 = "f8002c90", int extranonce2_size = 4)
+{
+    return new Subscribe(session_id, extranonce1, extranonce2_size);
+}
+
 void test_create_job()
 {
     // https://bitcoin.stackexchange.com/questions/22929/full-example-data-for-scrypt-stratum-client
 
-    std::vector<std::string> merkle_branch;
-    merkle_branch.push_back("57351e8569cb9d036187a79fd1844fd930c1309efcd16c46af9bb9713b6ee734");
-    merkle_branch.push_back("936ab9c33420f187acae660fcdb07ffdffa081273674f0f41e6ecc1347451d23");
+    Notification *notification = new Notification();
+    TEST_ASSERT_TRUE(notification->parse("b3ba", TEST_PREVHASH, TEST_COINB1, TEST_COINB2, "00000002", "1b44dfdb", "53178f9b", true));
+    TEST_ASSERT_TRUE(notification->addMerkleBranch("57351e8569cb9d036187a79fd1844fd930c1309efcd16c46af9bb9713b6ee734"));
+    TEST_ASSERT_TRUE(notification->addMerkleBranch("936ab9c33420f187acae660fcdb07ffdffa081273674f0f41e6ecc1347451d23"));
 
-    Notification *notification = new Notification("b3ba", "7dcf1304b04e79024066cd9481aa464e2fe17966e19edf6f33970e1fe0b60277", "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff270362f401062f503253482f049b8f175308", "0d2f7374726174756d506f6f6c2f000000000100868591052100001976a91431482118f1d7504daf1c001cbfaf91ad580d176d88ac00000000", merkle_branch, "00000002", "1b44dfdb", "53178f9b", true);
-
-    Subscribe *subscribe = new Subscribe("ae6812eb4cd7735a302a8a9dd95cf71f", "f8002c90", 4);
+    Subscribe *subscribe = makeSubscribe();
 
     Job *job = new Job(*notification, *subscribe, 0);
 
@@ -95,6 +129,316 @@ void test_create_job()
     }
 
     TEST_ASSERT_EQUAL_STRING(expected_hash, block_header_string);
+    TEST_ASSERT_EQUAL_STRING("00000002", job->getExtranonce2(0).c_str());
+}
+
+void test_job_version_rolling()
+{
+    Notification notification;
+    makeNotification(notification, "b3ba");
+    Subscribe *subscribe = makeSubscribe();
+    Job job(notification, *subscribe, 0, 0x1fffe000);
+    delete subscribe;
+
+    uint8_t share_target[32] = {};
+    nerdSHA256_range_result result;
+
+    // Core 0 keeps the pool's version, the other cores roll to their own
+    TEST_ASSERT_EQUAL_UINT32(64, job.pickaxe(0, 64, share_target, result));
+    TEST_ASSERT_EQUAL_HEX32(0, job.getVersionBits(0));
+#if CORE > 1
+    TEST_ASSERT_EQUAL_UINT32(64, job.pickaxe(1, 64, share_target, result));
+    TEST_ASSERT_EQUAL_HEX32(0x00002000, job.getVersionBits(1));
+#endif
+}
+
+// Merkle root of the example coinbase with the given extranonce2, hashed whole without the job's shortcuts
+static void rebuildMerkleRoot(const char *extranonce2, const char *branches[], size_t branch_count, uint8_t merkle_root[SHA256M_BLOCK_SIZE])
+{
+    std::string coinbase = std::string(TEST_COINB1) + "f8002c90" + extranonce2 + TEST_COINB2;
+    std::vector<uint8_t> coinbase_bytes(coinbase.length() / 2);
+    hexStringToByteArray(coinbase.c_str(), coinbase_bytes.data());
+    sha256_double(coinbase_bytes.data(), coinbase_bytes.size(), merkle_root);
+
+    uint8_t concatenated[SHA256M_BLOCK_SIZE * 2];
+    for (size_t i = 0; i < branch_count; i++)
+    {
+        memcpy(concatenated, merkle_root, SHA256M_BLOCK_SIZE);
+        hexStringToByteArray(branches[i], concatenated + SHA256M_BLOCK_SIZE);
+        sha256_double(concatenated, sizeof(concatenated), merkle_root);
+    }
+}
+
+void test_job_roll_extranonce2()
+{
+    const char *branches[] = {"57351e8569cb9d036187a79fd1844fd930c1309efcd16c46af9bb9713b6ee734", "936ab9c33420f187acae660fcdb07ffdffa081273674f0f41e6ecc1347451d23"};
+    Notification notification;
+    makeNotification(notification, "e1");
+    TEST_ASSERT_TRUE(notification.addMerkleBranch(branches[0]));
+    TEST_ASSERT_TRUE(notification.addMerkleBranch(branches[1]));
+    Subscribe *subscribe = makeSubscribe();
+    Job job(notification, *subscribe, 0);
+    delete subscribe;
+
+    uint8_t merkle_root[SHA256M_BLOCK_SIZE];
+    rebuildMerkleRoot("00000002", branches, 2, merkle_root);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(merkle_root, job.getHeader().merkle_root, SHA256M_BLOCK_SIZE);
+
+    // The rolled header is the one a job built from scratch with the next extranonce2 would have
+    TEST_ASSERT_TRUE(job.rollExtranonce2());
+    uint8_t share_target[32] = {};
+    nerdSHA256_range_result result;
+    TEST_ASSERT_EQUAL_UINT32(64, job.pickaxe(0, 64, share_target, result));
+    TEST_ASSERT_EQUAL_STRING("00000003", job.getExtranonce2(0).c_str());
+    TEST_ASSERT_FALSE(memcmp(merkle_root, job.getHeader().merkle_root, SHA256M_BLOCK_SIZE) == 0);
+
+    Block expected = job.block;
+    rebuildMerkleRoot("00000003", branches, 2, expected.merkle_root);
+    expected.nonce = 0;
+    TEST_ASSERT_EQUAL_UINT8_ARRAY((uint8_t *)&expected, (uint8_t *)&job.getHeader(), sizeof(Block));
+
+    // With one byte of extranonce2 every value but the starting one can be rolled to, then the job is exhausted
+    subscribe = makeSubscribe("ae6812eb4cd7735a302a8a9dd95cf71f", "f8002c90", 1);
+    Job small(notification, *subscribe, 0);
+    delete subscribe;
+
+    uint32_t rolls = 0;
+    while (small.rollExtranonce2())
+    {
+        rolls++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(255, rolls);
+    TEST_ASSERT_TRUE(small.isExhausted());
+
+    // The last header stays on 01, it never wraps back to the starting 02
+    rebuildMerkleRoot("01", branches, 2, merkle_root);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(merkle_root, small.getHeader().merkle_root, SHA256M_BLOCK_SIZE);
+}
+
+void test_job_handoff()
+{
+    Notification notification;
+    makeNotification(notification, "a1");
+    current_setSubscribe(makeSubscribe());
+    current_setJob(notification);
+
+    Job *first = current_job_acquire(0);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_EQUAL_STRING("a1", first->job_id.c_str());
+
+    // The held job survives the next publish, the worker moves to the new one at its next batch
+    notification.job_id[1] = '2';
+    current_setJob(notification);
+    TEST_ASSERT_EQUAL_STRING("a1", first->job_id.c_str());
+    TEST_ASSERT_EQUAL_STRING("a2", current_job_acquire(0)->job_id.c_str());
+    TEST_ASSERT_EQUAL_STRING("a2", current_getJobId());
+
+    // Shares find their job by epoch, even the previous one
+    const uint32_t epoch = current_job_epoch(0);
+    TEST_ASSERT_EQUAL_STRING("a2", current_job_lookup(epoch)->job_id);
+    TEST_ASSERT_EQUAL_STRING("a1", current_job_lookup(epoch - 1)->job_id);
+    TEST_ASSERT_EQUAL_INT(4, current_job_lookup(epoch)->extranonce2_size);
+    current_job_release(0);
+
+    current_job_invalidate();
+    TEST_ASSERT_NULL(current_job_acquire(0));
+    current_job_release(0);
+}
+
+void test_job_queue()
+{
+    Notification notification;
+    makeNotification(notification, "b1");
+    current_setSubscribe(makeSubscribe());
+    current_setJob(notification);
+
+    // Without clean_jobs the new job waits for the current one to be exhausted
+    notification.clean_jobs = false;
+    notification.job_id[1] = '2';
+    current_setJob(notification);
+    TEST_ASSERT_EQUAL_STRING("b1", current_getJobId());
+
+    current_job_acquire(0);
+    current_job_exhausted(0);
+    current_job_service();
+    TEST_ASSERT_EQUAL_STRING("b2", current_getJobId());
+
+    // clean_jobs preempts and drops what is queued
+    notification.job_id[1] = '3';
+    current_setJob(notification);
+    notification.clean_jobs = true;
+    notification.job_id[1] = '4';
+    current_setJob(notification);
+    TEST_ASSERT_EQUAL_STRING("b4", current_getJobId());
+    current_job_invalidate();
+    TEST_ASSERT_FALSE(current_hasJob());
+}
+
+void test_job_session_reset()
+{
+    Notification notification;
+    makeNotification(notification, "d1");
+    current_setSubscribe(makeSubscribe());
+    current_setJob(notification);
+    current_job_acquire(0);
+    const uint32_t epoch = current_job_epoch(0);
+    current_job_release(0);
+
+    // After a reconnect the miners keep the old job, but its shares are not submitted
+    current_resetSession();
+    TEST_ASSERT_TRUE(current_hasJob());
+    TEST_ASSERT_FALSE(current_hasSessionJob());
+    TEST_ASSERT_FALSE(current_job_in_session(epoch));
+
+    // The first notify of the new session preempts it even without clean_jobs
+    current_setSubscribe(makeSubscribe("be6812eb4cd7735a302a8a9dd95cf71f", "f8002c91"));
+    notification.clean_jobs = false;
+    notification.job_id[1] = '2';
+    current_setJob(notification);
+    TEST_ASSERT_EQUAL_STRING("d2", current_getJobId());
+    current_job_acquire(0);
+    TEST_ASSERT_TRUE(current_job_in_session(current_job_epoch(0)));
+    current_job_release(0);
+
+    // The next ones queue behind it again
+    notification.job_id[1] = '3';
+    current_setJob(notification);
+    TEST_ASSERT_EQUAL_STRING("d2", current_getJobId());
+
+    current_job_invalidate();
+    current_job_invalidate();
+    TEST_ASSERT_FALSE(current_hasJob());
+}
+
+void test_job_version_mask()
+{
+    Notification notification;
+    makeNotification(notification, "c1");
+    current_setSubscribe(makeSubscribe());
+    current_setJob(notification);
+    current_job_acquire(0);
+    const uint32_t epoch = current_job_epoch(0);
+    current_job_release(0);
+
+    // A new mask applies to the job being mined, republished in the next epoch
+    current_setVersionMask(0x1fffe000);
+    Job *job = current_job_acquire(0);
+    TEST_ASSERT_EQUAL_STRING("c1", job->job_id.c_str());
+    TEST_ASSERT_EQUAL_HEX32(0x1fffe000, job->version_mask);
+    TEST_ASSERT_EQUAL_UINT32(epoch + 1, current_job_epoch(0));
+    current_job_release(0);
+
+    // Shares found before the change keep the old mask
+    TEST_ASSERT_EQUAL_HEX32(0x1fffe000, current_job_lookup(epoch + 1)->version_mask);
+    TEST_ASSERT_EQUAL_HEX32(0, current_job_lookup(epoch)->version_mask);
+
+    current_job_invalidate();
+    current_setVersionMask(0);
+}
+
+void test_notification_invalid()
+{
+    Notification notification;
+
+    // Odd length, not hex, short prevhash
+    TEST_ASSERT_FALSE(notification.parse("1", "7dcf", "010", "0d2f", "00000002", "1b44dfdb", "53178f9b", true));
+    TEST_ASSERT_FALSE(notification.parse("1", TEST_PREVHASH, "01zz", "0d2f", "00000002", "1b44dfdb", "53178f9b", true));
+    TEST_ASSERT_FALSE(notification.addMerkleBranch("57351e85"));
+}
+
+StratumMessage stratum_last;
+uint32_t stratum_count = 0;
+
+void stratum_handler(StratumMessage &message)
+{
+    stratum_last = message;
+    stratum_count++;
+}
+
+void test_stratum_parser()
+{
+    StratumParser parser;
+    Notification notification;
+    parser.setNotification(&notification);
+
+    // A notify split across reads, the hex fields are decoded as they arrive
+    const char *notify = "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"b1\",\"7dcf1304b04e79024066cd9481aa464e2fe17966e19edf6f33970e1fe0b60277\","
+                         "\"01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff270362f401062f503253482f049b8f175308\","
+                         "\"0d2f7374726174756d506f6f6c2f000000000100868591052100001976a91431482118f1d7504daf1c001cbfaf91ad580d176d88ac00000000\","
+                         "[\"57351e8569cb9d036187a79fd1844fd930c1309efcd16c46af9bb9713b6ee734\"],\"20000000\",\"1b44dfdb\",\"53178f9b\",true]}\n";
+    const size_t split = 100;
+    TEST_ASSERT_EQUAL_INT(0, parser.feed((const uint8_t *)notify, split, stratum_handler));
+    TEST_ASSERT_FALSE(parser.isIdle());
+    TEST_ASSERT_EQUAL_INT(1, parser.feed((const uint8_t *)notify + split, strlen(notify) - split, stratum_handler));
+    TEST_ASSERT_TRUE(parser.isIdle());
+    TEST_ASSERT_EQUAL_STRING("mining.notify", stratum_last.method);
+    TEST_ASSERT_FALSE(stratum_last.has_id);
+    TEST_ASSERT_EQUAL_INT(9, stratum_last.param_count);
+    TEST_ASSERT_TRUE(stratum_last.notification_valid);
+    TEST_ASSERT_TRUE(notification.setHeader(stratum_last.param_text[0], stratum_last.param_text[5], stratum_last.param_text[6], stratum_last.param_text[7], stratum_last.param_bool[8]));
+
+    Notification expected;
+    makeNotification(expected, "b1");
+    TEST_ASSERT_TRUE(expected.addMerkleBranch("57351e8569cb9d036187a79fd1844fd930c1309efcd16c46af9bb9713b6ee734"));
+    TEST_ASSERT_EQUAL_STRING(expected.job_id, notification.job_id);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.prevhash, notification.prevhash, NOTIFICATION_HASH_SIZE);
+    TEST_ASSERT_EQUAL_INT(expected.coinb1_size, notification.coinb1_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.coinb1, notification.coinb1, expected.coinb1_size);
+    TEST_ASSERT_EQUAL_INT(expected.coinb2_size, notification.coinb2_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.coinb2, notification.coinb2, expected.coinb2_size);
+    TEST_ASSERT_EQUAL_INT(1, notification.merkle_branch_count);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.merkle_branch[0], notification.merkle_branch[0], NOTIFICATION_HASH_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(expected.version, notification.version);
+    TEST_ASSERT_TRUE(notification.clean_jobs);
+
+    // Subscribe result and a rejected share in one read, after a malformed line that is skipped
+    const char *lines = "{\"id\":1,\"result\":[[[\"mining.notify\",\"ae6812eb4cd7735a302a8a9dd95cf71f\"],[\"mining.set_difficulty\",\"1\"]],\"f8002c90\",4],\"error\":null}\n"
+                        "{\"id\":2,\"result\":tru\n"
+                        "{\"id\":7,\"result\":null,\"error\":[21,\"Job not found\",null]}\n";
+    stratum_count = 0;
+    const char *second = strchr(lines, '\n') + 1;
+    parser.feed((const uint8_t *)lines, second - lines, stratum_handler);
+    TEST_ASSERT_TRUE(stratum_last.is_subscribe);
+    TEST_ASSERT_EQUAL_STRING("ae6812eb4cd7735a302a8a9dd95cf71f", stratum_last.subscription_id);
+    TEST_ASSERT_EQUAL_STRING("f8002c90", stratum_last.extranonce1);
+    TEST_ASSERT_EQUAL_INT(4, stratum_last.extranonce2_size);
+    parser.feed((const uint8_t *)second, strlen(second), stratum_handler);
+    TEST_ASSERT_EQUAL_INT(2, stratum_count);
+    TEST_ASSERT_TRUE(stratum_last.has_id);
+    TEST_ASSERT_EQUAL_INT(7, stratum_last.id);
+    TEST_ASSERT_EQUAL_INT(STRATUM_NULL, stratum_last.result);
+    TEST_ASSERT_EQUAL_INT(21, stratum_last.error_code);
+}
+
+void test_notification_oversized()
+{
+    // A coinb2 one byte past the buffer is rejected, not truncated
+    std::string coinb2(NOTIFICATION_COINB2_SIZE * 2 + 2, 'a');
+    Notification notification;
+    TEST_ASSERT_FALSE(notification.parse("e1", TEST_PREVHASH, TEST_COINB1, coinb2.c_str(), "20000000", "1b44dfdb", "53178f9b", true));
+    coinb2.resize(NOTIFICATION_COINB2_SIZE * 2);
+    TEST_ASSERT_TRUE(notification.parse("e1", TEST_PREVHASH, TEST_COINB1, coinb2.c_str(), "20000000", "1b44dfdb", "53178f9b", true));
+    TEST_ASSERT_EQUAL_INT(NOTIFICATION_COINB2_SIZE, notification.coinb2_size);
+
+    // Streamed, the parser flags it so the notify is counted as dropped for its size
+    coinb2.append("aa");
+    std::string notify = std::string("{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"e2\",\"") + TEST_PREVHASH + "\",\"" + TEST_COINB1 + "\",\"" +
+                         coinb2 + "\",[],\"20000000\",\"1b44dfdb\",\"53178f9b\",true]}\n";
+    StratumParser parser;
+    parser.setNotification(&notification);
+    TEST_ASSERT_EQUAL_INT(1, parser.feed((const uint8_t *)notify.c_str(), notify.length(), stratum_handler));
+    TEST_ASSERT_TRUE(parser.isIdle());
+    TEST_ASSERT_FALSE(stratum_last.notification_valid);
+    TEST_ASSERT_TRUE(stratum_last.coinbase_oversized);
+    TEST_ASSERT_EQUAL_INT(0, notification.coinb2_size);
+
+    // The next notify that fits goes through
+    coinb2.resize(NOTIFICATION_COINB2_SIZE * 2);
+    notify.replace(notify.find(coinb2 + "aa"), coinb2.length() + 2, coinb2);
+    TEST_ASSERT_EQUAL_INT(1, parser.feed((const uint8_t *)notify.c_str(), notify.length(), stratum_handler));
+    TEST_ASSERT_TRUE(stratum_last.notification_valid);
+    TEST_ASSERT_FALSE(stratum_last.coinbase_oversized);
+    TEST_ASSERT_EQUAL_INT(NOTIFICATION_COINB2_SIZE, notification.coinb2_size);
 }
 
 void test_double_sha256m()
@@ -129,6 +473,48 @@ void test_double_sha256m()
     TEST_ASSERT_EQUAL_STRING(expected_double_hash, hash_string);
 }
 
+void test_sha256_context()
+{
+    uint8_t msg[150];
+    for (size_t i = 0; i < sizeof(msg); i++)
+    {
+        msg[i] = i * 7;
+    }
+
+    uint8_t expected[SHA256M_BLOCK_SIZE];
+    sha256_double(msg, sizeof(msg), expected);
+
+    // Prefix ending in the middle of a block, resumed from a clone
+    sha256m_context prefix;
+    sha256_init(&prefix);
+    sha256_update(&prefix, msg, 70);
+    sha256_update(&prefix, msg + 70, 64);
+
+    uint8_t hash[SHA256M_BLOCK_SIZE];
+    sha256_double_from(&prefix, msg + 134, sizeof(msg) - 134, hash);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, hash, SHA256M_BLOCK_SIZE);
+
+    // The prefix context is still usable
+    sha256_double_from(&prefix, msg + 134, sizeof(msg) - 134, hash);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, hash, SHA256M_BLOCK_SIZE);
+}
+
+void test_sha256d_64()
+{
+    uint8_t node[SHA256M_BUFFER_SIZE];
+    for (size_t i = 0; i < sizeof(node); i++)
+    {
+        node[i] = 0xff - i;
+    }
+
+    uint8_t expected[SHA256M_BLOCK_SIZE];
+    sha256_double(node, sizeof(node), expected);
+
+    uint8_t hash[SHA256M_BLOCK_SIZE];
+    sha256d_64(node, hash);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, hash, SHA256M_BLOCK_SIZE);
+}
+
 void test_nerdminer()
 {
     const char *msg = "0200000017975b97c18ed1f7e255adf297599b55330edab87803c81701000000000000008a97295a2747b4f1a0b3948df3990344c0e19fa6b2b92b3a19c8e6badc141787358b0553535f011948750833";
@@ -170,6 +556,84 @@ void test_nerdminer()
     TEST_ASSERT_TRUE(is_valid);
 }
 
+void test_nerdminer_range()
+{
+    const char *msg = "0200000017975b97c18ed1f7e255adf297599b55330edab87803c81701000000000000008a97295a2747b4f1a0b3948df3990344c0e19fa6b2b92b3a19c8e6badc141787358b0553535f011948750833";
+    uint8_t msg_bytes[80];
+    hexStringToByteArray(msg, msg_bytes);
+
+    const char *expected_hash = "0000000000000000e067a478024addfecdc93628978aa52d91fabd4292982a50";
+    const uint32_t winning_nonce = 856192328;
+
+    Target target;
+    target.calculate("19015f53");
+
+    nerdSHA256_context sha;
+    nerd_mids(&sha, msg_bytes);
+
+    nerdSHA256_range_result result;
+    uint32_t scanned = nerd_sha256d_range(&sha, winning_nonce - 100, 200, target.value, &result);
+
+    TEST_ASSERT_EQUAL_UINT32(200, scanned);
+    TEST_ASSERT_EQUAL_UINT32(1, result.count);
+    TEST_ASSERT_EQUAL_UINT32(winning_nonce, result.nonce[0]);
+
+    char hash_string[65];
+    hexInverse(result.hash[0], 32, hash_string);
+    TEST_ASSERT_EQUAL_STRING(expected_hash, hash_string);
+}
+
+#if NERD_INTERLEAVE > 1
+void test_nerdminer_interleaved()
+{
+    const char *msg = "0200000017975b97c18ed1f7e255adf297599b55330edab87803c81701000000000000008a97295a2747b4f1a0b3948df3990344c0e19fa6b2b92b3a19c8e6badc141787358b0553535f011948750833";
+    uint8_t msg_bytes[80];
+    hexStringToByteArray(msg, msg_bytes);
+
+    const char *expected_hash = "0000000000000000e067a478024addfecdc93628978aa52d91fabd4292982a50";
+    const uint32_t winning_nonce = 856192328;
+
+    nerdSHA256_context sha;
+    nerd_mids(&sha, msg_bytes);
+
+    nerdSHA256_range_result result;
+    uint32_t scanned = nerd_sha256d_range_interleaved(&sha, winning_nonce - 7, 13, nullptr, &result);
+
+    TEST_ASSERT_EQUAL_UINT32(13, scanned);
+    TEST_ASSERT_EQUAL_UINT32(1, result.count);
+    TEST_ASSERT_EQUAL_UINT32(winning_nonce, result.nonce[0]);
+
+    char hash_string[65];
+    hexInverse(result.hash[0], 32, hash_string);
+    TEST_ASSERT_EQUAL_STRING(expected_hash, hash_string);
+}
+#endif // NERD_INTERLEAVE
+
+void test_engine_self_test()
+{
+    size_t count;
+    const hash_engine *engines = engine_list(count);
+    TEST_ASSERT_TRUE(count > 0);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_TRUE_MESSAGE(engine_self_test(&engines[i]), engines[i].name);
+    }
+
+    engine_setup();
+    TEST_ASSERT_NOT_NULL(engine_get());
+}
+
+void test_tuner_sweep()
+{
+    const tuner_point point = tuner_sweep();
+
+    TEST_ASSERT_TRUE(point.batch_size >= 256 && point.batch_size <= 4096);
+    TEST_ASSERT_TRUE(point.yield_ms > 0);
+    TEST_ASSERT_TRUE(point.hashrate > 0);
+    TEST_ASSERT_TRUE(point.max_gap_ms <= TUNER_MAX_GAP_MS);
+}
+
 void test_performance_nerdminer()
 {
     uint8_t blockheader[80] = {0};
@@ -203,6 +667,29 @@ void test_performance_nerdminer()
     sprintf(result, "NERD - Midstate final: avg. ~%lld microseconds\n", elapsedTime);
     Serial.print(result);
 
+    // Cycles per hash of the whole midstate-based double hash
+    uint32_t startCycles = ESP.getCycleCount();
+    for (size_t i = 0; i < 1000; i++)
+    {
+        nerd_sha256d(&sha, blockheader + 64, hash);
+    }
+    uint32_t nerdCycles = (ESP.getCycleCount() - startCycles) / 1000;
+
+    // Same hash with two plain 64 round compressions, the baseline for the precomputed rounds
+    uint8_t generic_hash[32];
+    startCycles = ESP.getCycleCount();
+    for (size_t i = 0; i < 1000; i++)
+    {
+        nerd_sha256d_generic(&sha, blockheader + 64, generic_hash);
+    }
+    uint32_t genericCycles = (ESP.getCycleCount() - startCycles) / 1000;
+
+    sprintf(result, "NERD - %u cycles/hash, generic: %u cycles/hash, saved: %d cycles/hash\n", nerdCycles, genericCycles, (int)genericCycles - (int)nerdCycles);
+    Serial.print(result);
+
+    // A miss only writes the last word on the early exit path
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(generic_hash + 28, hash + 28, 4);
+
     TEST_ASSERT_FALSE(is_valid);
 }
 
@@ -213,9 +700,27 @@ void setup()
     UNITY_BEGIN();
     RUN_TEST(test_create_block_and_mine);
     RUN_TEST(test_create_target);
+    RUN_TEST(test_create_share_target);
     RUN_TEST(test_create_job);
+    RUN_TEST(test_job_version_rolling);
+    RUN_TEST(test_job_roll_extranonce2);
+    RUN_TEST(test_job_handoff);
+    RUN_TEST(test_job_queue);
+    RUN_TEST(test_job_session_reset);
+    RUN_TEST(test_job_version_mask);
+    RUN_TEST(test_notification_invalid);
+    RUN_TEST(test_stratum_parser);
+    RUN_TEST(test_notification_oversized);
     RUN_TEST(test_double_sha256m);
+    RUN_TEST(test_sha256_context);
+    RUN_TEST(test_sha256d_64);
     RUN_TEST(test_nerdminer);
+    RUN_TEST(test_nerdminer_range);
+#if NERD_INTERLEAVE > 1
+    RUN_TEST(test_nerdminer_interleaved);
+#endif
+    RUN_TEST(test_engine_self_test);
+    RUN_TEST(test_tuner_sweep);
 
     // Performance Testing
     RUN_TEST(test_performance_nerdminer);
@@ -0,0 +1,346 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "miner/nerdSHA256plus.h"
+#include "miner/nonceallocator.h"
+#include "network/sharering.h"
+#include "network/inflight.h"
+#include "network/submit.h"
+
+// Host build of the hashing kernels (env:native), no Arduino dependencies
+
+static void hexToBytes(const char *hex, uint8_t *output)
+{
+    for (size_t i = 0; hex[i * 2] != '\0'; i++)
+    {
+        sscanf(hex + i * 2, "%2hhx", &output[i]);
+    }
+}
+
+static void hashToString(const uint8_t *hash, char *output)
+{
+    for (int i = 31; i >= 0; i--)
+    {
+        sprintf(output + (31 - i) * 2, "%02x", hash[i]);
+    }
+}
+
+static const char *header = "0200000017975b97c18ed1f7e255adf297599b55330edab87803c81701000000000000008a97295a2747b4f1a0b3948df3990344c0e19fa6b2b92b3a19c8e6badc141787358b0553535f011948750833";
+static const char *expected_hash = "0000000000000000e067a478024addfecdc93628978aa52d91fabd4292982a50";
+static const uint32_t winning_nonce = 856192328;
+
+void test_nerdminer()
+{
+    uint8_t msg_bytes[80];
+    hexToBytes(header, msg_bytes);
+
+    nerdSHA256_context sha;
+    nerd_mids(&sha, msg_bytes);
+    uint8_t hash[32];
+    TEST_ASSERT_TRUE(nerd_sha256d(&sha, msg_bytes + 64, hash));
+
+    char hash_string[65];
+    hashToString(hash, hash_string);
+    TEST_ASSERT_EQUAL_STRING(expected_hash, hash_string);
+}
+
+#if NERD_INTERLEAVE > 1
+void test_nerdminer_interleaved()
+{
+    uint8_t msg_bytes[80];
+    hexToBytes(header, msg_bytes);
+
+    nerdSHA256_context sha;
+    nerd_mids(&sha, msg_bytes);
+
+    // Odd start and count so the winning nonce lands in every lane position across the runs
+    for (uint32_t offset = 0; offset < NERD_INTERLEAVE; offset++)
+    {
+        nerdSHA256_range_result result;
+        uint32_t scanned = nerd_sha256d_range_interleaved(&sha, winning_nonce - 7 - offset, 13, nullptr, &result);
+        TEST_ASSERT_EQUAL_UINT32(13, scanned);
+        TEST_ASSERT_EQUAL_UINT32(1, result.count);
+        TEST_ASSERT_EQUAL_UINT32(winning_nonce, result.nonce[0]);
+
+        char hash_string[65];
+        hashToString(result.hash[0], hash_string);
+        TEST_ASSERT_EQUAL_STRING(expected_hash, hash_string);
+    }
+}
+
+void test_interleaved_matches_scalar()
+{
+    uint8_t blockheader[80];
+    for (int i = 0; i < 80; i++)
+    {
+        blockheader[i] = i * 7;
+    }
+
+    nerdSHA256_context sha;
+    nerd_mids(&sha, blockheader);
+
+    uint32_t candidates = 0;
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        nerdSHA256_range_result scalar, interleaved;
+        const uint32_t start = i * 65537;
+        TEST_ASSERT_EQUAL_UINT32(nerd_sha256d_range(&sha, start, 65535, nullptr, &scalar),
+                                 nerd_sha256d_range_interleaved(&sha, start, 65535, nullptr, &interleaved));
+        TEST_ASSERT_EQUAL_UINT32(scalar.count, interleaved.count);
+        for (uint32_t j = 0; j < scalar.count; j++)
+        {
+            TEST_ASSERT_EQUAL_UINT32(scalar.nonce[j], interleaved.nonce[j]);
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(scalar.hash[j], interleaved.hash[j], 32);
+        }
+        candidates += scalar.count;
+    }
+    TEST_ASSERT_TRUE(candidates > 0);
+}
+#endif // NERD_INTERLEAVE
+
+static double nsPerHash(uint32_t (*kernel)(nerdSHA256_context *, uint32_t, uint32_t, const uint8_t *, nerdSHA256_range_result *), nerdSHA256_context *sha)
+{
+    // A zero target keeps every candidate out of the results, the whole batch is always scanned
+    const uint8_t target[32] = {0};
+    nerdSHA256_range_result result;
+    uint32_t scanned = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        scanned += kernel(sha, i * 1000, 1000, target, &result);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / scanned;
+}
+
+static double nsPerHash(uint8_t (*hash)(nerdSHA256_context *, uint8_t *, uint8_t *), nerdSHA256_context *sha, uint8_t *blockheader)
+{
+    uint8_t digest[32];
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t nonce = 0; nonce < 1000000; nonce++)
+    {
+        memcpy(blockheader + 76, &nonce, sizeof(nonce));
+        hash(sha, blockheader + 64, digest);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / 1000000;
+}
+
+void test_performance_kernels()
+{
+    uint8_t blockheader[80] = {0};
+    nerdSHA256_context sha;
+    nerd_mids(&sha, blockheader);
+
+    // The generic loop runs every round of both compressions, the others skip what the midstate and the fixed padding allow
+    double generic = nsPerHash(nerd_sha256d_generic, &sha, blockheader);
+    double single = nsPerHash(nerd_sha256d, &sha, blockheader);
+    double scalar = nsPerHash(nerd_sha256d_range, &sha);
+
+    printf("\nNERD - generic: %.1f ns/hash, nerd_sha256d: %.1f ns/hash, scalar: %.1f ns/hash, saved: %.1f%%\n",
+           generic, single, scalar, 100.0 * (generic - scalar) / generic);
+#if NERD_INTERLEAVE > 1
+    printf("NERD - interleaved x%d: %.1f ns/hash\n", NERD_INTERLEAVE, nsPerHash(nerd_sha256d_range_interleaved, &sha));
+#endif
+}
+
+void test_generic_baseline()
+{
+    uint8_t msg_bytes[80];
+    hexToBytes(header, msg_bytes);
+
+    nerdSHA256_context sha;
+    nerd_mids(&sha, msg_bytes);
+    uint8_t hash[32];
+    uint8_t generic_hash[32];
+    TEST_ASSERT_TRUE(nerd_sha256d(&sha, msg_bytes + 64, hash));
+    TEST_ASSERT_TRUE(nerd_sha256d_generic(&sha, msg_bytes + 64, generic_hash));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(hash, generic_hash, 32);
+
+    // On a miss the early exit only writes the last word, which must still agree
+    msg_bytes[76] ^= 0x5a;
+    TEST_ASSERT_FALSE(nerd_sha256d(&sha, msg_bytes + 64, hash));
+    TEST_ASSERT_FALSE(nerd_sha256d_generic(&sha, msg_bytes + 64, generic_hash));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(hash + 28, generic_hash + 28, 4);
+}
+
+void test_nonce_allocator()
+{
+    NonceAllocator nonces;
+    std::vector<uint32_t> claimed[2];
+
+    // Two workers drain the whole nonce space at the same time
+    auto worker = [&nonces](std::vector<uint32_t> *out)
+    {
+        uint32_t start;
+        while (nonces.next(start))
+        {
+            out->push_back(start);
+        }
+    };
+    std::thread a(worker, &claimed[0]);
+    std::thread b(worker, &claimed[1]);
+    a.join();
+    b.join();
+
+    TEST_ASSERT_TRUE(nonces.isExhausted());
+    TEST_ASSERT_EQUAL_UINT32(NONCE_RANGE_COUNT, claimed[0].size() + claimed[1].size());
+
+    // Every range given out exactly once
+    std::vector<bool> seen(NONCE_RANGE_COUNT, false);
+    for (const auto &ranges : claimed)
+    {
+        for (uint32_t start : ranges)
+        {
+            TEST_ASSERT_EQUAL_UINT32(0, start % NONCE_RANGE_SIZE);
+            TEST_ASSERT_FALSE(seen[start >> NONCE_RANGE_BITS]);
+            seen[start >> NONCE_RANGE_BITS] = true;
+        }
+    }
+
+    nonces.reset();
+    uint32_t start = 1;
+    TEST_ASSERT_TRUE(nonces.next(start));
+    TEST_ASSERT_EQUAL_UINT32(0, start);
+}
+
+void test_share_ring()
+{
+    ShareRing ring;
+    const uint32_t total = 100000;
+    std::vector<uint32_t> received;
+
+    // One miner pushes while the network side pops, shares come out whole and in order
+    std::thread producer([&ring]()
+    {
+        Share share = {};
+        for (uint32_t nonce = 0; nonce < total;)
+        {
+            share.nonce = nonce;
+            share.extranonce2 = (uint64_t)nonce << 32 | nonce;
+            share.ntime = ~nonce;
+            if (ring.push(share))
+            {
+                nonce++;
+            }
+        }
+    });
+    Share share;
+    while (received.size() < total)
+    {
+        if (ring.pop(share))
+        {
+            TEST_ASSERT_EQUAL_UINT64((uint64_t)share.nonce << 32 | share.nonce, share.extranonce2);
+            TEST_ASSERT_EQUAL_UINT32(~share.nonce, share.ntime);
+            received.push_back(share.nonce);
+        }
+    }
+    producer.join();
+
+    for (uint32_t i = 0; i < total; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(i, received[i]);
+    }
+    TEST_ASSERT_FALSE(ring.pop(share));
+
+    // A full ring drops instead of overwriting
+    ShareRing full;
+    for (uint32_t i = 0; i < SHARE_RING_SIZE; i++)
+    {
+        TEST_ASSERT_TRUE(full.push(share));
+    }
+    TEST_ASSERT_FALSE(full.push(share));
+    TEST_ASSERT_EQUAL_UINT32(1, full.getDropped());
+}
+
+void test_inflight_table()
+{
+    InflightTable table;
+    InflightRequest request;
+
+    // Responses come back in any order, each one finds its own request
+    table.add(1, INFLIGHT_SUBSCRIBE, 100);
+    table.add(2, INFLIGHT_SUBMIT, 110, 7, 0xdeadbeef);
+    table.add(3, INFLIGHT_SUBMIT, 120, 8, 0xcafebabe);
+    TEST_ASSERT_EQUAL_UINT32(3, table.getPending());
+    TEST_ASSERT_TRUE(table.take(3, request));
+    TEST_ASSERT_EQUAL_UINT32(INFLIGHT_SUBMIT, request.method);
+    TEST_ASSERT_EQUAL_UINT32(8, request.epoch);
+    TEST_ASSERT_EQUAL_UINT32(0xcafebabe, request.nonce);
+    TEST_ASSERT_TRUE(table.take(2, request));
+    TEST_ASSERT_EQUAL_UINT32(0xdeadbeef, request.nonce);
+    TEST_ASSERT_EQUAL_UINT32(110, request.sent);
+
+    // Answered, unknown or overwritten ids are not matched
+    TEST_ASSERT_FALSE(table.take(3, request));
+    TEST_ASSERT_FALSE(table.take(42, request));
+    table.add(1 + INFLIGHT_SIZE, INFLIGHT_SUBMIT, 130);
+    TEST_ASSERT_FALSE(table.take(1, request));
+    TEST_ASSERT_EQUAL_UINT32(1, table.getLost());
+
+    // Requests without a response expire
+    TEST_ASSERT_EQUAL_UINT32(0, table.expire(140, 100));
+    TEST_ASSERT_EQUAL_UINT32(1, table.expire(240, 100));
+    TEST_ASSERT_EQUAL_UINT32(0, table.getPending());
+    TEST_ASSERT_EQUAL_UINT32(2, table.getLost());
+}
+
+void test_submit_template()
+{
+    SubmitTemplate submit;
+
+    // Only the holes change between shares, the rest is rendered once per job
+    TEST_ASSERT_TRUE(submit.render(3, 7, "bc1qwallet.worker", "4f2a", 4, 0x53178f9b, false));
+    size_t length = submit.patch(7, 0xab, 0xdeadbeef, 0);
+    const char *expected = "{\"id\":7,\"method\":\"mining.submit\",\"params\":[\"bc1qwallet.worker\",\"4f2a\",\"000000AB\",\"53178f9b\",\"deadbeef\"]}\n";
+    TEST_ASSERT_EQUAL_UINT32(strlen(expected), length);
+    TEST_ASSERT_EQUAL_STRING(expected, submit.getPayload());
+    TEST_ASSERT_TRUE(submit.isRenderedFor(3, 9));
+    TEST_ASSERT_FALSE(submit.isRenderedFor(4, 9));
+
+    // The id hole fits the digits it was rendered for, a longer id needs a new render
+    TEST_ASSERT_FALSE(submit.isRenderedFor(3, 10));
+    TEST_ASSERT_TRUE(submit.render(3, 18446744073709551615ULL, "bc1qwallet.worker", "4f2a", 4, 0x53178f9b, false));
+    length = submit.patch(18446744073709551615ULL, 0xffffffff, 1, 0);
+    expected = "{\"id\":18446744073709551615,\"method\":\"mining.submit\",\"params\":[\"bc1qwallet.worker\",\"4f2a\",\"FFFFFFFF\",\"53178f9b\",\"00000001\"]}\n";
+    TEST_ASSERT_EQUAL_UINT32(strlen(expected), length);
+    TEST_ASSERT_EQUAL_STRING(expected, submit.getPayload());
+
+    // Version rolling adds the version bits
+    TEST_ASSERT_TRUE(submit.render(4, 12, "w", "j", 2, 0x01020304, true));
+    submit.patch(12, 0x1234, 0x0a0b0c0d, 0x1fffe000);
+    expected = "{\"id\":12,\"method\":\"mining.submit\",\"params\":[\"w\",\"j\",\"1234\",\"01020304\",\"0a0b0c0d\",\"1fffe000\"]}\n";
+    TEST_ASSERT_EQUAL_STRING(expected, submit.getPayload());
+
+    // Doesn't fit the payload
+    char wallet[SUBMIT_PAYLOAD_SIZE];
+    memset(wallet, 'w', sizeof(wallet) - 1);
+    wallet[sizeof(wallet) - 1] = '\0';
+    TEST_ASSERT_FALSE(submit.render(5, 1, wallet, "j", 4, 0, false));
+    TEST_ASSERT_FALSE(submit.isRenderedFor(5, 1));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_nerdminer);
+    RUN_TEST(test_generic_baseline);
+#if NERD_INTERLEAVE > 1
+    RUN_TEST(test_nerdminer_interleaved);
+    RUN_TEST(test_interleaved_matches_scalar);
+#endif
+    RUN_TEST(test_nonce_allocator);
+    RUN_TEST(test_share_ring);
+    RUN_TEST(test_inflight_table);
+    RUN_TEST(test_submit_template);
+
+    // Performance Testing
+    RUN_TEST(test_performance_kernels);
+
+    return UNITY_END();
+}